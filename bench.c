@@ -0,0 +1,256 @@
+/**
+ * bench.c -- runs the input corpus under every broad phase and reports frame times
+ *
+ * Each input is simulated for a fixed number of frames under each mode, after
+ * some warmup runs that are not recorded.  Per-frame times from all recorded
+ * runs are pooled into min / median / p99.  One row is printed per
+ * (input, mode) as CSV, or as a JSON array with -j.
+ *
+ * Exits with status 1 if the collision counts for an input differ between
+ * modes, or between repetitions of the same mode.
+ **/
+
+#include "./fasttime.h"
+
+#include <glob.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./line_demo.h"
+
+#define DEFAULT_INPUT_PATTERN "input/*.in"
+#define DEFAULT_NUM_FRAMES 100
+#define DEFAULT_NUM_WARMUP 1
+#define DEFAULT_NUM_REPS 5
+
+typedef struct BenchMode {
+  const char* name;
+  BroadPhase broadPhase;
+  bool parallel;
+  bool parallelSolver;
+  bool pairCache;
+} BenchMode;
+
+static const BenchMode benchModes[] = {
+  { "n2",               BROAD_PHASE_N2,               false, false, false },
+  { "quad_tree",        BROAD_PHASE_QUAD_TREE,        false, false, false },
+  { "quad_tree_par",    BROAD_PHASE_QUAD_TREE,        true,  false, false },
+  { "grid",             BROAD_PHASE_GRID,             false, false, false },
+  { "sweep",            BROAD_PHASE_SWEEP,            false, false, false },
+  { "linear_quad_tree", BROAD_PHASE_LINEAR_QUAD_TREE, false, false, false },
+  { "bvh",              BROAD_PHASE_BVH,              false, false, false },
+  { "parallel_solver",  BROAD_PHASE_QUAD_TREE,        true,  true,  false },
+  { "pair_cache",       BROAD_PHASE_QUAD_TREE,        false, false, true  },
+};
+#define NUM_BENCH_MODES (sizeof(benchModes) / sizeof(benchModes[0]))
+
+typedef struct BenchResult {
+  unsigned int numLines;
+  double minFrame;
+  double medianFrame;
+  double p99Frame;
+  double linesPerSecond;
+  unsigned int lineWallCollisions;
+  unsigned int lineLineCollisions;
+  bool repsAgree;
+} BenchResult;
+
+static int compareDoubles(const void* a, const void* b) {
+  const double x = *(const double*) a;
+  const double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+// Runs one simulation of numFrames frames.  If frameTimes is not NULL the time
+// of each frame is written to it.
+static LineDemo* runOnce(char* inputPath, const BenchMode* mode,
+                         const unsigned int numFrames, double* frameTimes) {
+  LineDemo* lineDemo = LineDemo_new();
+  LineDemo_setInputFile(inputPath);
+  LineDemo_initLine(lineDemo, mode->broadPhase);
+  lineDemo->collisionWorld->using_parallel_detection = mode->parallel;
+  lineDemo->collisionWorld->using_parallel_solver = mode->parallelSolver;
+  lineDemo->collisionWorld->using_pair_cache = mode->pairCache;
+
+  for (unsigned int f = 0; f < numFrames; f++) {
+    const fasttime_t start = gettime();
+    CollisionWorld_updateLines(lineDemo->collisionWorld);
+    const fasttime_t end = gettime();
+    if (frameTimes != NULL) {
+      frameTimes[f] = tdiff(start, end);
+    }
+  }
+  return lineDemo;
+}
+
+static BenchResult benchMode(char* inputPath, const BenchMode* mode,
+                             const unsigned int numFrames,
+                             const unsigned int numWarmup,
+                             const unsigned int numReps) {
+  for (unsigned int w = 0; w < numWarmup; w++) {
+    LineDemo_delete(runOnce(inputPath, mode, numFrames, NULL));
+  }
+
+  const unsigned int numSamples = numFrames * numReps;
+  double* frameTimes = malloc(numSamples * sizeof(double));
+  if (frameTimes == NULL) {
+    fprintf(stderr, "Couldn't allocate frame times\n");
+    exit(1);
+  }
+
+  BenchResult result;
+  result.repsAgree = true;
+  for (unsigned int r = 0; r < numReps; r++) {
+    LineDemo* lineDemo = runOnce(inputPath, mode, numFrames,
+                                 &frameTimes[r * numFrames]);
+    const unsigned int wall = LineDemo_getNumLineWallCollisions(lineDemo);
+    const unsigned int line = LineDemo_getNumLineLineCollisions(lineDemo);
+    if (r == 0) {
+      result.numLines = LineDemo_getNumOfLines(lineDemo);
+      result.lineWallCollisions = wall;
+      result.lineLineCollisions = line;
+    } else if (wall != result.lineWallCollisions
+               || line != result.lineLineCollisions) {
+      result.repsAgree = false;
+    }
+    LineDemo_delete(lineDemo);
+  }
+
+  double totalTime = 0;
+  for (unsigned int s = 0; s < numSamples; s++) {
+    totalTime += frameTimes[s];
+  }
+  qsort(frameTimes, numSamples, sizeof(double), compareDoubles);
+  result.minFrame = frameTimes[0];
+  result.medianFrame = frameTimes[numSamples / 2];
+  result.p99Frame = frameTimes[(unsigned int) ((numSamples - 1) * 0.99)];
+  result.linesPerSecond = totalTime > 0
+                          ? (double) result.numLines * numSamples / totalTime
+                          : 0;
+
+  free(frameTimes);
+  return result;
+}
+
+static void printResult(const bool json, const bool first, const char* inputPath,
+                        const BenchMode* mode, const unsigned int numFrames,
+                        const unsigned int numReps, const BenchResult* result) {
+  if (json) {
+    printf("%s  {\"input\": \"%s\", \"mode\": \"%s\", \"lines\": %u, "
+           "\"frames\": %u, \"reps\": %u, \"min_ms\": %.6f, "
+           "\"median_ms\": %.6f, \"p99_ms\": %.6f, \"lines_per_sec\": %.1f, "
+           "\"line_wall_collisions\": %u, \"line_line_collisions\": %u}",
+           first ? "" : ",\n", inputPath, mode->name, result->numLines,
+           numFrames, numReps, result->minFrame * 1e3,
+           result->medianFrame * 1e3, result->p99Frame * 1e3,
+           result->linesPerSecond, result->lineWallCollisions,
+           result->lineLineCollisions);
+  } else {
+    printf("%s,%s,%u,%u,%u,%.6f,%.6f,%.6f,%.1f,%u,%u\n", inputPath, mode->name,
+           result->numLines, numFrames, numReps, result->minFrame * 1e3,
+           result->medianFrame * 1e3, result->p99Frame * 1e3,
+           result->linesPerSecond, result->lineWallCollisions,
+           result->lineLineCollisions);
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  int optchar;
+  unsigned int numFrames = DEFAULT_NUM_FRAMES;
+  unsigned int numWarmup = DEFAULT_NUM_WARMUP;
+  unsigned int numReps = DEFAULT_NUM_REPS;
+  bool json = false;
+  extern int optind;
+  extern char* optarg;
+
+  while ((optchar = getopt(argc, argv, "f:w:r:j")) != -1) {
+    switch (optchar) {
+      case 'f':
+        numFrames = atoi(optarg);
+        break;
+      case 'w':
+        numWarmup = atoi(optarg);
+        break;
+      case 'r':
+        numReps = atoi(optarg);
+        break;
+      case 'j':
+        json = true;
+        break;
+      default:
+        printf("Usage: %s [-f frames] [-w warmup] [-r reps] [-j] [inputfile...]\n",
+               argv[0]);
+        printf("  -f : frames per run (default %d)\n", DEFAULT_NUM_FRAMES);
+        printf("  -w : unrecorded warmup runs per mode (default %d)\n",
+               DEFAULT_NUM_WARMUP);
+        printf("  -r : recorded runs per mode (default %d)\n", DEFAULT_NUM_REPS);
+        printf("  -j : print JSON instead of CSV\n");
+        printf("  inputs default to %s\n", DEFAULT_INPUT_PATTERN);
+        exit(-1);
+    }
+  }
+  if (numFrames == 0 || numReps == 0) {
+    fprintf(stderr, "Need at least one frame and one rep\n");
+    exit(-1);
+  }
+
+  glob_t inputGlob;
+  char** inputs = &argv[optind];
+  size_t numInputs = argc - optind;
+  if (numInputs == 0) {
+    if (glob(DEFAULT_INPUT_PATTERN, 0, NULL, &inputGlob) != 0) {
+      fprintf(stderr, "No inputs match %s\n", DEFAULT_INPUT_PATTERN);
+      exit(1);
+    }
+    inputs = inputGlob.gl_pathv;
+    numInputs = inputGlob.gl_pathc;
+  }
+
+  if (json) {
+    printf("[\n");
+  } else {
+    printf("input,mode,lines,frames,reps,min_ms,median_ms,p99_ms,"
+           "lines_per_sec,line_wall_collisions,line_line_collisions\n");
+  }
+
+  bool failed = false;
+  bool first = true;
+  for (size_t i = 0; i < numInputs; i++) {
+    BenchResult results[NUM_BENCH_MODES];
+    for (size_t m = 0; m < NUM_BENCH_MODES; m++) {
+      results[m] = benchMode(inputs[i], &benchModes[m], numFrames, numWarmup,
+                             numReps);
+      printResult(json, first, inputs[i], &benchModes[m], numFrames, numReps,
+                  &results[m]);
+      first = false;
+
+      if (!results[m].repsAgree) {
+        fprintf(stderr, "FAIL %s: %s collision counts differ between reps\n",
+                inputs[i], benchModes[m].name);
+        failed = true;
+      }
+      if (results[m].lineWallCollisions != results[0].lineWallCollisions
+          || results[m].lineLineCollisions != results[0].lineLineCollisions) {
+        fprintf(stderr, "FAIL %s: %s counts (%u wall, %u line) differ from "
+                "%s (%u wall, %u line)\n", inputs[i], benchModes[m].name,
+                results[m].lineWallCollisions, results[m].lineLineCollisions,
+                benchModes[0].name, results[0].lineWallCollisions,
+                results[0].lineLineCollisions);
+        failed = true;
+      }
+    }
+  }
+
+  if (json) {
+    printf("\n]\n");
+  }
+  if (inputs != &argv[optind]) {
+    globfree(&inputGlob);
+  }
+
+  return failed ? 1 : 0;
+}
@@ -1 +1 @@
-clang -o a.out -std=gnu99 screensaver.c line_demo.c vec.c intersection_event_list.c intersection_detection.c collision_world.c graphic_stuff.c quad_tree/quad_tree.c quad_tree/free_list.c quad_tree/small_list.c -lm -lrt -lX11
+clang -o a.out -std=gnu99 screensaver.c line_demo.c vec.c intersection_event_list.c intersection_detection.c collision_world.c line_store.c phase_timing.c scene_file.c graphic_stuff.c quad_tree/quad_tree.c quad_tree/linear_quad_tree.c spatial_grid/spatial_grid.c sweep_and_prune/sweep_and_prune.c bvh/bvh.c quad_tree/free_list.c quad_tree/small_list.c quad_tree/frame_arena.c -lm -lrt -lX11
@@ -0,0 +1,314 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../quad_tree/logging.h"
+#include "bvh.h"
+
+// PRIVATE DECLARATIONS
+static void         Bvh_Reserve(Bvh* bvh, const unsigned int num_lines);
+static unsigned int Bvh_BuildNode(Bvh* bvh, const unsigned int first, const unsigned int count);
+static void         Bvh_SelectMedian(Bvh* bvh, unsigned int* ids, const unsigned int count, const int axis);
+static void         Bvh_Refit(Bvh* bvh);
+static void         Bvh_SelfPairs(const Bvh* bvh, const unsigned int node, BvhPairCallback callback, void* data);
+static void         Bvh_CrossPairs(const Bvh* bvh, const unsigned int node_a, const unsigned int node_b,
+                                   BvhPairCallback callback, void* data);
+
+
+// INLINES
+static inline BvhBox Bvh_GetBox(const LineStore* lines, const unsigned int line_id, const double time_step) {
+  BvhBox box;
+  LineStore_sweptBox(lines, line_id, time_step, &box.min_x, &box.max_x, &box.min_y, &box.max_y);
+  return box;
+}
+
+static inline void Bvh_GrowBox(BvhBox* box, const BvhBox* other) {
+  box->min_x = fmin(box->min_x, other->min_x);
+  box->min_y = fmin(box->min_y, other->min_y);
+  box->max_x = fmax(box->max_x, other->max_x);
+  box->max_y = fmax(box->max_y, other->max_y);
+}
+
+static inline bool Bvh_BoxesOverlap(const BvhBox* a, const BvhBox* b) {
+  return a->min_x <= b->max_x && b->min_x <= a->max_x &&
+         a->min_y <= b->max_y && b->min_y <= a->max_y;
+}
+
+// 2D stand in for surface area, a query box hits a node about this often
+static inline double Bvh_Perimeter(const BvhBox* box) {
+  return (box->max_x - box->min_x) + (box->max_y - box->min_y);
+}
+
+static inline double Bvh_Centroid(const BvhBox* box, const int axis) {
+  return axis == 0 ? box->min_x + box->max_x : box->min_y + box->max_y;
+}
+
+static inline bool Bvh_IsLeaf(const BvhNode* node) {
+  return node->left < 0;
+}
+
+static inline void Bvh_Emit(BvhPairCallback callback, void* data,
+                            const unsigned int line_a, const unsigned int line_b) {
+  callback(data, line_a < line_b ? line_a : line_b, line_a < line_b ? line_b : line_a);
+}
+
+
+// PUBLIC
+void Bvh_Init(Bvh* bvh, const LineStore* lines) {
+  assert(bvh);
+  assert(lines);
+
+  bvh->lines        = lines;
+  bvh->boxes        = NULL;
+  bvh->line_order   = NULL;
+  bvh->num_lines    = 0;
+  bvh->nodes        = NULL;
+  bvh->num_nodes    = 0;
+  bvh->build_cost   = 0.0;
+  bvh->cost         = 0.0;
+  bvh->num_rebuilds = 0;
+}
+
+void Bvh_Free(Bvh* bvh) {
+  assert(bvh);
+
+  free(bvh->boxes);
+  free(bvh->line_order);
+  free(bvh->nodes);
+  Bvh_Init(bvh, bvh->lines);
+}
+
+void Bvh_Update(Bvh* bvh, const unsigned int num_lines, const double time_step) {
+  assert(bvh);
+
+  const bool starting_over = bvh->num_lines != num_lines || bvh->nodes == NULL;
+  if(starting_over) {
+    Bvh_Reserve(bvh, num_lines);
+  }
+
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    bvh->boxes[i] = Bvh_GetBox(bvh->lines, i, time_step);
+  }
+
+  // refitting keeps every box conservative however far the lines move, a
+  // rebuild is only needed once the boxes overlap so much that walking is slow
+  if(starting_over) {
+    Bvh_Rebuild(bvh);
+    return;
+  }
+  Bvh_Refit(bvh);
+  if(bvh->cost > BVH_REBUILD_RATIO * bvh->build_cost) {
+    Bvh_Rebuild(bvh);
+  }
+}
+
+void Bvh_Rebuild(Bvh* bvh) {
+  assert(bvh);
+
+  bvh->num_nodes = 0;
+  for(unsigned int i = 0; i < bvh->num_lines; ++i) {
+    bvh->line_order[i] = i;
+  }
+  if(bvh->num_lines > 0) {
+    Bvh_BuildNode(bvh, 0, bvh->num_lines);
+  }
+
+  double cost = 0.0;
+  for(unsigned int n = 0; n < bvh->num_nodes; ++n) {
+    cost += Bvh_Perimeter(&bvh->nodes[n].box);
+  }
+  bvh->build_cost = cost;
+  bvh->cost       = cost;
+  bvh->num_rebuilds++;
+}
+
+void Bvh_ForEachCandidatePair(const Bvh* bvh, BvhPairCallback callback, void* data) {
+  assert(bvh);
+  assert(callback);
+
+  if(bvh->num_nodes > 0) {
+    Bvh_SelfPairs(bvh, 0, callback, data);
+  }
+}
+
+
+// PRIVATE
+static void Bvh_Reserve(Bvh* bvh, const unsigned int num_lines) {
+  free(bvh->boxes);
+  free(bvh->line_order);
+  free(bvh->nodes);
+  // a binary tree with at least one line per leaf has under 2n nodes
+  bvh->boxes      = malloc(num_lines * sizeof(BvhBox));
+  bvh->line_order = malloc(num_lines * sizeof(unsigned int));
+  bvh->nodes      = malloc((2 * num_lines + 1) * sizeof(BvhNode));
+  if(!bvh->boxes || !bvh->line_order || !bvh->nodes) {
+    LOG("%s(): Couldn't malloc for bvh\n", __func__);
+    exit(1);
+  }
+  bvh->num_lines = num_lines;
+  bvh->num_nodes = 0;
+}
+
+// Top down median split on the longest axis of the line centers. Children are
+// built after their parent so the nodes end up in depth first order.
+static unsigned int Bvh_BuildNode(Bvh* bvh, const unsigned int first, const unsigned int count) {
+  assert(count > 0);
+  assert(bvh->num_nodes < 2 * bvh->num_lines + 1);
+
+  const unsigned int index = bvh->num_nodes++;
+  unsigned int* ids = &bvh->line_order[first];
+
+  BvhBox box     = bvh->boxes[ids[0]];
+  double c_min_x = Bvh_Centroid(&box, 0);
+  double c_max_x = c_min_x;
+  double c_min_y = Bvh_Centroid(&box, 1);
+  double c_max_y = c_min_y;
+  for(unsigned int i = 1; i < count; ++i) {
+    const BvhBox* line_box = &bvh->boxes[ids[i]];
+    Bvh_GrowBox(&box, line_box);
+    c_min_x = fmin(c_min_x, Bvh_Centroid(line_box, 0));
+    c_max_x = fmax(c_max_x, Bvh_Centroid(line_box, 0));
+    c_min_y = fmin(c_min_y, Bvh_Centroid(line_box, 1));
+    c_max_y = fmax(c_max_y, Bvh_Centroid(line_box, 1));
+  }
+
+  BvhNode* node = &bvh->nodes[index];
+  node->box   = box;
+  node->first = first;
+  node->count = count;
+  node->left  = -1;
+  node->right = -1;
+  if(count <= BVH_LEAF_SIZE) {
+    return index;
+  }
+
+  const int axis = (c_max_x - c_min_x) >= (c_max_y - c_min_y) ? 0 : 1;
+  Bvh_SelectMedian(bvh, ids, count, axis);
+
+  const unsigned int half  = count / 2;
+  const int left  = (int)Bvh_BuildNode(bvh, first, half);
+  const int right = (int)Bvh_BuildNode(bvh, first + half, count - half);
+  bvh->nodes[index].left  = left;
+  bvh->nodes[index].right = right;
+  return index;
+}
+
+// Quickselect: afterwards ids[count / 2] has the median center on axis,
+// everything before it is no greater and everything after no less
+static void Bvh_SelectMedian(Bvh* bvh, unsigned int* ids, const unsigned int count, const int axis) {
+  const unsigned int k = count / 2;
+  unsigned int lo = 0;
+  unsigned int hi = count - 1;
+  while(lo < hi) {
+    const double pivot = Bvh_Centroid(&bvh->boxes[ids[lo + (hi - lo) / 2]], axis);
+    unsigned int i = lo;
+    unsigned int j = hi;
+    while(i <= j) {
+      while(Bvh_Centroid(&bvh->boxes[ids[i]], axis) < pivot) {
+        ++i;
+      }
+      while(Bvh_Centroid(&bvh->boxes[ids[j]], axis) > pivot) {
+        --j;
+      }
+      if(i <= j) {
+        const unsigned int temp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = temp;
+        ++i;
+        if(j == 0) {
+          break;
+        }
+        --j;
+      }
+    }
+    if(k <= j) {
+      hi = j;
+    }
+    else if(k >= i) {
+      lo = i;
+    }
+    else {
+      return;
+    }
+  }
+}
+
+// Children come after their parent, so walking the nodes backwards visits
+// every child before the node that covers it
+static void Bvh_Refit(Bvh* bvh) {
+  double cost = 0.0;
+  for(unsigned int n = bvh->num_nodes; n-- > 0;) {
+    BvhNode* node = &bvh->nodes[n];
+    if(Bvh_IsLeaf(node)) {
+      const unsigned int* ids = &bvh->line_order[node->first];
+      node->box = bvh->boxes[ids[0]];
+      for(unsigned int i = 1; i < node->count; ++i) {
+        Bvh_GrowBox(&node->box, &bvh->boxes[ids[i]]);
+      }
+    }
+    else {
+      node->box = bvh->nodes[node->left].box;
+      Bvh_GrowBox(&node->box, &bvh->nodes[node->right].box);
+    }
+    cost += Bvh_Perimeter(&node->box);
+  }
+  bvh->cost = cost;
+}
+
+// Every pair of lines under node: pairs inside each child plus pairs across them
+static void Bvh_SelfPairs(const Bvh* bvh, const unsigned int node_id, BvhPairCallback callback, void* data) {
+  const BvhNode* node = &bvh->nodes[node_id];
+  if(Bvh_IsLeaf(node)) {
+    const unsigned int* ids = &bvh->line_order[node->first];
+    for(unsigned int i = 0; i < node->count; ++i) {
+      for(unsigned int j = i + 1; j < node->count; ++j) {
+        if(Bvh_BoxesOverlap(&bvh->boxes[ids[i]], &bvh->boxes[ids[j]])) {
+          Bvh_Emit(callback, data, ids[i], ids[j]);
+        }
+      }
+    }
+    return;
+  }
+
+  Bvh_SelfPairs(bvh, node->left, callback, data);
+  Bvh_SelfPairs(bvh, node->right, callback, data);
+  Bvh_CrossPairs(bvh, node->left, node->right, callback, data);
+}
+
+// Pairs with one line under node_a and the other under node_b. The two
+// subtrees are disjoint so every pair comes out once.
+static void Bvh_CrossPairs(const Bvh* bvh, const unsigned int node_a, const unsigned int node_b,
+                           BvhPairCallback callback, void* data) {
+  const BvhNode* a = &bvh->nodes[node_a];
+  const BvhNode* b = &bvh->nodes[node_b];
+  if(!Bvh_BoxesOverlap(&a->box, &b->box)) {
+    return;
+  }
+
+  if(Bvh_IsLeaf(a) && Bvh_IsLeaf(b)) {
+    const unsigned int* ids_a = &bvh->line_order[a->first];
+    const unsigned int* ids_b = &bvh->line_order[b->first];
+    for(unsigned int i = 0; i < a->count; ++i) {
+      const BvhBox* box_a = &bvh->boxes[ids_a[i]];
+      if(!Bvh_BoxesOverlap(box_a, &b->box)) {
+        continue;
+      }
+      for(unsigned int j = 0; j < b->count; ++j) {
+        if(Bvh_BoxesOverlap(box_a, &bvh->boxes[ids_b[j]])) {
+          Bvh_Emit(callback, data, ids_a[i], ids_b[j]);
+        }
+      }
+    }
+    return;
+  }
+
+  // descend into the bigger node so the two boxes shrink at about the same rate
+  if(Bvh_IsLeaf(b) || (!Bvh_IsLeaf(a) && Bvh_Perimeter(&a->box) >= Bvh_Perimeter(&b->box))) {
+    Bvh_CrossPairs(bvh, a->left, node_b, callback, data);
+    Bvh_CrossPairs(bvh, a->right, node_b, callback, data);
+  }
+  else {
+    Bvh_CrossPairs(bvh, node_a, b->left, callback, data);
+    Bvh_CrossPairs(bvh, node_a, b->right, callback, data);
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdbool.h>
+
+#include "../line.h"
+#include "../line_store.h"
+
+// Lines per leaf before a node is split
+#define BVH_LEAF_SIZE 4
+
+// Rebuild once refitting has grown the summed perimeter of the nodes by this much
+#define BVH_REBUILD_RATIO 1.5
+
+// Bounding box of a line's swept parallelogram, box coordinates, see LineStore_sweptBox
+typedef struct BvhBox {
+  double min_x;
+  double min_y;
+  double max_x;
+  double max_y;
+} BvhBox;
+
+// Nodes are stored in depth first order, so a node's children always come after it
+// .box:          covers every line below this node
+// .left, .right: child node indices, -1 for a leaf
+// .first, .count: a leaf's lines are line_order[first] .. line_order[first + count - 1]
+typedef struct BvhNode {
+  BvhBox       box;
+  int          left;
+  int          right;
+  unsigned int first;
+  unsigned int count;
+} BvhNode;
+
+// Called once for every pair of lines whose boxes overlap, line_a < line_b
+typedef void (*BvhPairCallback)(void* data, const unsigned int line_a, const unsigned int line_b);
+
+// Bounding volume hierarchy over the lines' swept boxes.
+// Every line is in exactly one leaf no matter how long it is. After the first build
+// the tree keeps its shape and the boxes are refit bottom up each frame. When the
+// refit boxes have grown too loose (see BVH_REBUILD_RATIO) the tree is rebuilt.
+typedef struct Bvh {
+  // Bvh does not own this memory !!!
+  const LineStore* lines;
+
+  BvhBox*       boxes;       // indexed by line id
+  unsigned int* line_order;  // line ids grouped by leaf
+  unsigned int  num_lines;
+
+  BvhNode*     nodes;
+  unsigned int num_nodes;
+
+  // summed perimeter of every node right after the last rebuild, and now
+  double       build_cost;
+  double       cost;
+  unsigned int num_rebuilds;
+} Bvh;
+
+void Bvh_Init(Bvh* bvh, const LineStore* lines);
+void Bvh_Free(Bvh* bvh);
+// Refits the tree to the lines' current swept boxes, rebuilding it on the first
+// call, when the number of lines changes or when the rebuild heuristic says so
+void Bvh_Update(Bvh* bvh, const unsigned int num_lines, const double time_step);
+void Bvh_Rebuild(Bvh* bvh);
+// Self collision traversal: hands every pair of lines whose boxes overlap to callback once
+void Bvh_ForEachCandidatePair(const Bvh* bvh, BvhPairCallback callback, void* data);
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * classify_check.c -- compares the quad tree's quadrant classifiers on real inputs
+ *
+ * Each input is simulated for some frames.  Every frame the quad tree is built
+ * and each line is walked down it.  At every branch node the line reaches
+ * under either classifier, the separating axis classifier
+ * (QuadTree_ClassifySwept) and the old slope classifier
+ * (QuadTree_ClassifySweptBySlopes) are asked which quadrants the line's
+ * swept parallelogram reaches.  Both answers are checked against the
+ * parallelogram clipped to the quadrant.  For the separating axis classifier
+ * the quadrant is widened by the drift of integer child sizes and left open past
+ * the root's edges, as the tree routes lines.  The slope classifier is only
+ * held to the part of the quadrant inside the node.
+ *
+ * One CSV row is printed per input.  Exits with status 1 if the separating
+ * axis classifier ever misses a quadrant the clipped parallelogram reaches.
+ **/
+
+#include <glob.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./line_demo.h"
+
+#define DEFAULT_INPUT_PATTERN "input/*.in"
+#define DEFAULT_NUM_FRAMES 100
+
+// A parallelogram clipped by 4 half planes has at most 4 + 4 vertices
+#define MAX_CLIP_VERTICES 8
+
+typedef struct ClassifyCounts {
+  unsigned long checks;        // (line, branch node, quadrant) triples
+  unsigned long reached;       // ...where the parallelogram clipped to the quadrant is not empty
+  unsigned long reached_node;  // ...and stays so when the quadrant is kept inside the node
+  unsigned long sat_hits;
+  unsigned long slope_hits;
+  unsigned long sat_misses;    // reached but not flagged by the SAT classifier
+  unsigned long slope_misses;  // reached inside the node but not flagged by the slope classifier
+  unsigned long disagree;      // the two classifiers gave different answers
+} ClassifyCounts;
+
+// Keeps the part of polygon in[] with sign * (coord - mid) <= 0, the
+// vertices on the line count as inside.  Returns the number of vertices kept.
+static int clipHalfPlane(const double* in_x, const double* in_y, const int n,
+                         double* out_x, double* out_y,
+                         const bool along_x, const double mid, const double sign) {
+  int m = 0;
+  for (int i = 0; i < n; i++) {
+    const int j = (i + 1) % n;
+    const double di = sign * ((along_x ? in_x[i] : in_y[i]) - mid);
+    const double dj = sign * ((along_x ? in_x[j] : in_y[j]) - mid);
+    if (di <= 0) {
+      out_x[m] = in_x[i];
+      out_y[m] = in_y[i];
+      m++;
+    }
+    if ((di <= 0) != (dj <= 0)) {
+      const double t = di / (di - dj);
+      out_x[m] = in_x[i] + t * (in_x[j] - in_x[i]);
+      out_y[m] = in_y[i] + t * (in_y[j] - in_y[i]);
+      m++;
+    }
+  }
+  return m;
+}
+
+// Whether the swept parallelogram reaches quadrant q (tl, bl, br, tr) of rect,
+// with the quadrant's outer edges pushed out by margin.  Outer edges pushed
+// past root's edges are dropped when open_past_root is set.
+static bool reachesQuadrant(const QuadSweptLine* swept, const QuadRect* rect,
+                            const QuadRect* root, const int q,
+                            const double margin, const bool open_past_root) {
+  static const double sign_x[4] = { -1.0, -1.0, 1.0,  1.0 };
+  static const double sign_y[4] = { -1.0,  1.0, 1.0, -1.0 };
+  // corners p1, p2, p2', p1' go round the parallelogram
+  double x[MAX_CLIP_VERTICES] = { swept->x[0], swept->x[1], swept->x[3], swept->x[2] };
+  double y[MAX_CLIP_VERTICES] = { swept->y[0], swept->y[1], swept->y[3], swept->y[2] };
+  double clipped_x[MAX_CLIP_VERTICES];
+  double clipped_y[MAX_CLIP_VERTICES];
+
+  // keep the quadrant's side of each mid line, -sign puts it on the <= 0 side
+  int n = clipHalfPlane(x, y, 4, clipped_x, clipped_y, true, rect->mid_x, -sign_x[q]);
+  n = clipHalfPlane(clipped_x, clipped_y, n, x, y, false, rect->mid_y, -sign_y[q]);
+
+  // and the inside of its outer edges
+  const double edge_x = rect->mid_x + sign_x[q] * (rect->size_x + margin);
+  const double edge_y = rect->mid_y + sign_y[q] * (rect->size_y + margin);
+  const bool open_x = open_past_root
+                      && sign_x[q] * (edge_x - root->mid_x) >= root->size_x;
+  const bool open_y = open_past_root
+                      && sign_y[q] * (edge_y - root->mid_y) >= root->size_y;
+  if (!open_x) {
+    n = clipHalfPlane(x, y, n, clipped_x, clipped_y, true, edge_x, sign_x[q]);
+    memcpy(x, clipped_x, n * sizeof(double));
+    memcpy(y, clipped_y, n * sizeof(double));
+  }
+  if (!open_y) {
+    n = clipHalfPlane(x, y, n, clipped_x, clipped_y, false, edge_y, sign_y[q]);
+  }
+  return n > 0;
+}
+
+static void checkNode(const QuadTree* qt, const QuadSweptLine* swept,
+                      const int index, const QuadNodeData node_data,
+                      ClassifyCounts* counts) {
+  const QuadNode* node = &qt->frozen_nodes[index];
+  if (node->count != -1) {
+    return;
+  }
+
+  const QuadRect rect = node_data.rect;
+  const BranchFlags sat = QuadTree_ClassifySwept(qt, swept, &node_data);
+  const BranchFlags slope = QuadTree_ClassifySweptBySlopes(swept, rect);
+  const bool sat_hit[4] = { sat.tl, sat.bl, sat.br, sat.tr };
+  const bool slope_hit[4] = { slope.tl, slope.bl, slope.br, slope.tr };
+  const int sign_x[4] = { -1, -1, 1,  1 };
+  const int sign_y[4] = { -1,  1, 1, -1 };
+
+  for (int q = 0; q < 4; q++) {
+    // child sizes drift by up to 1 per level, see QuadTree_ClassifySwept
+    const bool reached = reachesQuadrant(swept, &rect, &qt->root_rect, q,
+                                         node_data.depth, true);
+    const bool reached_node = reached
+                              && reachesQuadrant(swept, &rect, &qt->root_rect, q, 0, false);
+    counts->checks++;
+    counts->reached += reached;
+    counts->reached_node += reached_node;
+    counts->sat_hits += sat_hit[q];
+    counts->slope_hits += slope_hit[q];
+    counts->sat_misses += reached && !sat_hit[q];
+    counts->slope_misses += reached_node && !slope_hit[q];
+    counts->disagree += sat_hit[q] != slope_hit[q];
+
+    if (sat_hit[q] || slope_hit[q]) {
+      QuadNodeData child;
+      child.depth = node_data.depth + 1;
+      child.rect.size_x = rect.size_x >> 1;
+      child.rect.size_y = rect.size_y >> 1;
+      child.rect.mid_x = rect.mid_x + sign_x[q] * child.rect.size_x;
+      child.rect.mid_y = rect.mid_y + sign_y[q] * child.rect.size_y;
+      checkNode(qt, swept, node->first_child + q, child, counts);
+    }
+  }
+}
+
+static ClassifyCounts checkInput(char* inputPath, const unsigned int numFrames) {
+  ClassifyCounts counts = { 0 };
+
+  LineDemo* lineDemo = LineDemo_new();
+  LineDemo_setInputFile(inputPath);
+  LineDemo_initLine(lineDemo, BROAD_PHASE_QUAD_TREE);
+  CollisionWorld* collisionWorld = lineDemo->collisionWorld;
+  QuadTree* qt = collisionWorld->quad_tree;
+
+  for (unsigned int f = 0; f < numFrames; f++) {
+    // builds (and sweeps) the tree for this frame's positions, then moves on
+    CollisionWorld_updateLines(collisionWorld);
+    QuadTree_Build(qt, collisionWorld->numOfLines, collisionWorld->timeStep);
+    QuadTree_Freeze(qt);
+    QuadNodeData root;
+    root.rect = qt->root_rect;
+    root.depth = 0;
+    for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+      checkNode(qt, &qt->swept_lines[i], 0, root, &counts);
+    }
+  }
+
+  LineDemo_delete(lineDemo);
+  return counts;
+}
+
+int main(int argc, char *argv[]) {
+  int optchar;
+  unsigned int numFrames = DEFAULT_NUM_FRAMES;
+  extern int optind;
+  extern char* optarg;
+
+  while ((optchar = getopt(argc, argv, "f:")) != -1) {
+    switch (optchar) {
+      case 'f':
+        numFrames = atoi(optarg);
+        break;
+      default:
+        printf("Usage: %s [-f frames] [inputfile...]\n", argv[0]);
+        printf("  -f : frames per input (default %d)\n", DEFAULT_NUM_FRAMES);
+        printf("  inputs default to %s\n", DEFAULT_INPUT_PATTERN);
+        exit(-1);
+    }
+  }
+
+  glob_t inputGlob;
+  char** inputs = &argv[optind];
+  size_t numInputs = argc - optind;
+  if (numInputs == 0) {
+    if (glob(DEFAULT_INPUT_PATTERN, 0, NULL, &inputGlob) != 0) {
+      fprintf(stderr, "No inputs match %s\n", DEFAULT_INPUT_PATTERN);
+      exit(1);
+    }
+    inputs = inputGlob.gl_pathv;
+    numInputs = inputGlob.gl_pathc;
+  }
+
+  printf("input,frames,checks,reached,reached_node,sat_hits,slope_hits,"
+         "sat_misses,slope_misses,disagree\n");
+  bool failed = false;
+  for (size_t i = 0; i < numInputs; i++) {
+    const ClassifyCounts counts = checkInput(inputs[i], numFrames);
+    printf("%s,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", inputs[i], numFrames,
+           counts.checks, counts.reached, counts.reached_node, counts.sat_hits,
+           counts.slope_hits, counts.sat_misses, counts.slope_misses,
+           counts.disagree);
+    fflush(stdout);
+    if (counts.sat_misses > 0) {
+      fprintf(stderr, "FAIL %s: separating axis classifier missed %lu quadrants\n",
+              inputs[i], counts.sat_misses);
+      failed = true;
+    }
+  }
+
+  if (inputs != &argv[optind]) {
+    globfree(&inputGlob);
+  }
+  return failed ? 1 : 0;
+}
@@ -27,139 +27,744 @@
 #include <math.h>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "./intersection_detection.h"
 #include "./intersection_event_list.h"
 #include "./line.h"
+#include "./phase_timing.h"
+
+#ifdef __cilk
+#include <cilk/cilk.h>
+#else
+#define cilk_for for
+#endif
+
+// Number of lines handed to each parallel detection task
+#define DETECTION_CHUNK_SIZE 64
+
+// Number of candidates classified per intersectBatch call
+#define DETECTION_BATCH_SIZE 64
+
+// Starting size of the per-frame arena
+#define FRAME_ARENA_INITIAL_BYTES (64 * 1024)
+
+// A line's fattened box for the pair cache is its swept box grown by this many
+// frames of its own motion, and by at least this many frames of the average line's
+#define PAIR_CACHE_MARGIN_FRAMES 8
+
+// Relative gap between squared lengths that CollisionWorld_isShorter trusts
+#define IS_SHORTER_MIN_RATIO 1e-12
+
+// Number of lines moved by each parallel task of CollisionWorld_advanceLines
+#define ADVANCE_CHUNK_SIZE 4096
+
+// Classifies l1 against the candidate lines in l2Ids and appends the
+// intersections to the list.  Returns the number of intersections found.
+static unsigned int CollisionWorld_intersectCandidates(CollisionWorld* collisionWorld,
+                                                       const Line* l1,
+                                                       const unsigned int* l2Ids,
+                                                       const unsigned int numCandidates,
+                                                       IntersectionEventList* intersectionEventList) {
+  unsigned int numCollisions = 0;
+  unsigned int survivors[DETECTION_BATCH_SIZE];
+  IntersectionType results[DETECTION_BATCH_SIZE];
+  PHASE_TIMING_COUNT(COUNTER_CANDIDATES, numCandidates);
+  for (unsigned int start = 0; start < numCandidates; start += DETECTION_BATCH_SIZE) {
+    const unsigned int count = numCandidates - start < DETECTION_BATCH_SIZE ?
+                               numCandidates - start : DETECTION_BATCH_SIZE;
+    // only the candidates whose swept bounds meet l1's go on to the full test
+    const unsigned int numSurvivors = rejectDisjointBounds(l1, &collisionWorld->lineStore,
+                                                           &l2Ids[start], count,
+                                                           collisionWorld->timeStep, survivors);
+    PHASE_TIMING_COUNT(COUNTER_BOUNDS_REJECTS, count - numSurvivors);
+    if (numSurvivors == 0) {
+      continue;
+    }
+    intersectBatch(l1, &collisionWorld->lineStore, survivors, numSurvivors,
+                   collisionWorld->timeStep, results);
+    for (unsigned int k = 0; k < numSurvivors; k++) {
+      if (results[k] != NO_INTERSECTION) {
+        IntersectionEventList_append(intersectionEventList, l1->id,
+                                     survivors[k], results[k]);
+        numCollisions++;
+      }
+    }
+  }
+  return numCollisions;
+}
+
+// QuadTreePairCallback, records the pair for grouping.
+static void CollisionWorld_addCandidatePair(void* data, const unsigned int l1Id,
+                                            const unsigned int l2Id) {
+  CollisionWorld* collisionWorld = data;
+  if (collisionWorld->numCandidatePairs == collisionWorld->candidatePairsCapacity) {
+    unsigned int capacity = collisionWorld->candidatePairsCapacity * 2;
+    if (capacity == 0) {
+      capacity = 1024;
+    }
+    collisionWorld->candidatePairs = realloc(collisionWorld->candidatePairs,
+                                             2 * capacity * sizeof(unsigned int));
+    collisionWorld->candidateIds = realloc(collisionWorld->candidateIds,
+                                           capacity * sizeof(unsigned int));
+    if (collisionWorld->candidatePairs == NULL || collisionWorld->candidateIds == NULL) {
+      fprintf(stderr, "Couldn't allocate candidate pairs\n");
+      exit(1);
+    }
+    collisionWorld->candidatePairsCapacity = capacity;
+  }
+  unsigned int* pair = &collisionWorld->candidatePairs[2 * collisionWorld->numCandidatePairs];
+  pair[0] = l1Id;
+  pair[1] = l2Id;
+  collisionWorld->numCandidatePairs++;
+}
+
+// Counting sort of the candidate pairs by l1Id into candidateStart/candidateIds.
+static void CollisionWorld_groupCandidatePairs(CollisionWorld* collisionWorld) {
+  unsigned int* start = collisionWorld->candidateStart;
+  memset(start, 0, (collisionWorld->numOfLines + 1) * sizeof(unsigned int));
+  for (unsigned int p = 0; p < collisionWorld->numCandidatePairs; p++) {
+    start[collisionWorld->candidatePairs[2 * p] + 1]++;
+  }
+  for (unsigned int i = 1; i <= collisionWorld->numOfLines; i++) {
+    start[i] += start[i - 1];
+  }
+  // start[i] is used as the write cursor for line i, then shifted back
+  for (unsigned int p = 0; p < collisionWorld->numCandidatePairs; p++) {
+    const unsigned int* pair = &collisionWorld->candidatePairs[2 * p];
+    collisionWorld->candidateIds[start[pair[0]]++] = pair[1];
+  }
+  for (unsigned int i = collisionWorld->numOfLines; i > 0; i--) {
+    start[i] = start[i - 1];
+  }
+  start[0] = 0;
+}
+
+// Bounding box of line i and where it will be after time t, in box coordinates
+static inline void CollisionWorld_sweptBox(const LineStore* lineStore, const unsigned int i,
+                                           const double t, double* min_x, double* max_x,
+                                           double* min_y, double* max_y) {
+  const double move_x = lineStore->vx[i] * t;
+  const double move_y = lineStore->vy[i] * t;
+  *min_x = fmin(fmin(lineStore->p1x[i], lineStore->p2x[i]),
+                fmin(lineStore->p1x[i] + move_x, lineStore->p2x[i] + move_x));
+  *max_x = fmax(fmax(lineStore->p1x[i], lineStore->p2x[i]),
+                fmax(lineStore->p1x[i] + move_x, lineStore->p2x[i] + move_x));
+  *min_y = fmin(fmin(lineStore->p1y[i], lineStore->p2y[i]),
+                fmin(lineStore->p1y[i] + move_y, lineStore->p2y[i] + move_y));
+  *max_y = fmax(fmax(lineStore->p1y[i], lineStore->p2y[i]),
+                fmax(lineStore->p1y[i] + move_y, lineStore->p2y[i] + move_y));
+}
+
+// Whether the cached candidate pairs still hold this frame.  Two lines can only
+// hit each other if their swept boxes overlap, so as long as every swept box is
+// inside its fattened box every pair that can hit is among the cached ones.
+static bool CollisionWorld_pairCacheHolds(const CollisionWorld* collisionWorld) {
+  if (!collisionWorld->pairCacheValid) {
+    return false;
+  }
+  for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+    double min_x, max_x, min_y, max_y;
+    CollisionWorld_sweptBox(&collisionWorld->lineStore, i, collisionWorld->timeStep,
+                            &min_x, &max_x, &min_y, &max_y);
+    if (min_x < collisionWorld->pairCacheMinX[i] || collisionWorld->pairCacheMaxX[i] < max_x
+        || min_y < collisionWorld->pairCacheMinY[i] || collisionWorld->pairCacheMaxY[i] < max_y) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Works out the fattened box of every line from its swept box, see PAIR_CACHE_MARGIN_FRAMES.
+static void CollisionWorld_fattenBoxes(CollisionWorld* collisionWorld) {
+  const LineStore* lineStore = &collisionWorld->lineStore;
+  const unsigned int num_lines = collisionWorld->numOfLines;
+  const double t = collisionWorld->timeStep;
+  if (collisionWorld->pairCacheMinX == NULL) {
+    const unsigned int capacity = collisionWorld->lineStore.capacity;
+    collisionWorld->pairCacheMinX = malloc(capacity * sizeof(double));
+    collisionWorld->pairCacheMaxX = malloc(capacity * sizeof(double));
+    collisionWorld->pairCacheMinY = malloc(capacity * sizeof(double));
+    collisionWorld->pairCacheMaxY = malloc(capacity * sizeof(double));
+    if (collisionWorld->pairCacheMinX == NULL || collisionWorld->pairCacheMaxX == NULL
+        || collisionWorld->pairCacheMinY == NULL || collisionWorld->pairCacheMaxY == NULL) {
+      fprintf(stderr, "Couldn't allocate pair cache\n");
+      exit(1);
+    }
+  }
+
+  double total_speed = 0;
+  for (unsigned int i = 0; i < num_lines; i++) {
+    total_speed += sqrt(lineStore->vx[i] * lineStore->vx[i] + lineStore->vy[i] * lineStore->vy[i]);
+  }
+  const double min_margin = num_lines > 0 ?
+                            PAIR_CACHE_MARGIN_FRAMES * t * total_speed / num_lines : 0;
+
+  for (unsigned int i = 0; i < num_lines; i++) {
+    double min_x, max_x, min_y, max_y;
+    CollisionWorld_sweptBox(lineStore, i, t, &min_x, &max_x, &min_y, &max_y);
+    const double speed = sqrt(lineStore->vx[i] * lineStore->vx[i]
+                              + lineStore->vy[i] * lineStore->vy[i]);
+    const double margin = fmax(PAIR_CACHE_MARGIN_FRAMES * t * speed, min_margin);
+    collisionWorld->pairCacheMinX[i] = min_x - margin;
+    collisionWorld->pairCacheMaxX[i] = max_x + margin;
+    collisionWorld->pairCacheMinY[i] = min_y - margin;
+    collisionWorld->pairCacheMaxY[i] = max_y + margin;
+  }
+}
+
+// Candidate pairs for the pair cache without a tree: every pair of lines whose
+// fattened boxes overlap.
+static void CollisionWorld_addOverlappingBoxPairs(CollisionWorld* collisionWorld) {
+  const double* min_x = collisionWorld->pairCacheMinX;
+  const double* max_x = collisionWorld->pairCacheMaxX;
+  const double* min_y = collisionWorld->pairCacheMinY;
+  const double* max_y = collisionWorld->pairCacheMaxY;
+  for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+    for (unsigned int j = i + 1; j < collisionWorld->numOfLines; j++) {
+      if (min_x[j] <= max_x[i] && min_x[i] <= max_x[j]
+          && min_y[j] <= max_y[i] && min_y[i] <= max_y[j]) {
+        CollisionWorld_addCandidatePair(collisionWorld, i, j);
+      }
+    }
+  }
+}
+
+// Tests line i against every line after it (by ID) that it could hit, using the
+// broad phase (quad tree, grid, sort and sweep, bvh) or the n^2 search, and appends the intersections to the list.
+// Only reads collisionWorld so lines can be tested in parallel.
+// Returns the number of intersections found.
+static unsigned int CollisionWorld_detectLineIntersections(CollisionWorld* collisionWorld,
+                                                           const unsigned int i,
+                                                           IntersectionEventList* intersectionEventList) {
+  unsigned int numCollisions = 0;
+  Line l1 = LineStore_getLine(&collisionWorld->lineStore, i);
+
+  if(collisionWorld->using_pair_cache ||
+     collisionWorld->broad_phase == BROAD_PHASE_QUAD_TREE ||
+     collisionWorld->broad_phase == BROAD_PHASE_LINEAR_QUAD_TREE ||
+     collisionWorld->broad_phase == BROAD_PHASE_BVH) {
+    // pairs were already found and grouped by the pair walk (or kept in the pair cache)
+    const unsigned int start = collisionWorld->candidateStart[i];
+    const unsigned int num_candidates = collisionWorld->candidateStart[i + 1] - start;
+    numCollisions += CollisionWorld_intersectCandidates(collisionWorld, &l1,
+                                                        &collisionWorld->candidateIds[start],
+                                                        num_candidates, intersectionEventList);
+  }
+  else if(collisionWorld->broad_phase != BROAD_PHASE_N2) {
+    SmallList line_ids;
+    if(collisionWorld->broad_phase == BROAD_PHASE_GRID) {
+      line_ids = SpatialGrid_QueryLines(collisionWorld->spatial_grid, i);
+    }
+    else {
+      line_ids = SweepAndPrune_QueryLines(collisionWorld->sweep_and_prune, i);
+    }
+
+    // keep only the lines with compareLines(l1, l2) < 0, IDs are indices so
+    // this is just i < id. The list is compacted in place.
+    unsigned int num_candidates = 0;
+    for(unsigned int j = 0; j < line_ids.num_elements; ++j) {
+      unsigned int id;
+      SmallList_GetAtIndexCopy(&line_ids, j, &id);
+      if(i < id) {
+        SmallList_SetAtIndex(&line_ids, &id, num_candidates);
+        num_candidates++;
+      }
+    }
+
+    if(0 < num_candidates) {
+      const unsigned int* candidates = SmallList_GetAtIndexRef(&line_ids, 0);
+      numCollisions += CollisionWorld_intersectCandidates(collisionWorld, &l1, candidates,
+                                                          num_candidates, intersectionEventList);
+    }
+    SmallList_Free(&line_ids);
+  }
+  else {
+    // Test all line-line pairs to see if they will intersect before the
+    // next time step.
+    unsigned int candidates[DETECTION_BATCH_SIZE];
+    for (unsigned int j = i + 1; j < collisionWorld->numOfLines; j += DETECTION_BATCH_SIZE) {
+      unsigned int count = 0;
+      while (count < DETECTION_BATCH_SIZE && j + count < collisionWorld->numOfLines) {
+        candidates[count] = j + count;
+        count++;
+      }
+      numCollisions += CollisionWorld_intersectCandidates(collisionWorld, &l1, candidates,
+                                                          count, intersectionEventList);
+    }
+  }
+
+  return numCollisions;
+}
+
+// Solves the sorted events in batches whose events share no line, each batch in
+// parallel.  An event goes in the batch after the latest one holding either of
+// its lines, so events on the same line are solved in list order and every line
+// ends with the velocity the serial loop would give it.
+static void CollisionWorld_solveInBatches(CollisionWorld* collisionWorld,
+                                          const IntersectionEventList* intersectionEventList) {
+  const IntersectionEvent* events = intersectionEventList->events;
+  const unsigned int num_events = intersectionEventList->size;
+  if (num_events == 0) {
+    return;
+  }
+  if (collisionWorld->solverLineBatch == NULL) {
+    collisionWorld->solverLineBatch = calloc(collisionWorld->lineStore.capacity,
+                                             sizeof(unsigned int));
+    if (collisionWorld->solverLineBatch == NULL) {
+      fprintf(stderr, "Couldn't allocate solver batches\n");
+      exit(1);
+    }
+  }
+  if (num_events > collisionWorld->solverCapacity) {
+    unsigned int capacity = collisionWorld->solverCapacity * 2;
+    if (capacity < num_events) {
+      capacity = num_events;
+    }
+    collisionWorld->solverEventBatch = realloc(collisionWorld->solverEventBatch,
+                                               capacity * sizeof(unsigned int));
+    collisionWorld->solverOrder = realloc(collisionWorld->solverOrder,
+                                          capacity * sizeof(unsigned int));
+    collisionWorld->solverBatchStart = realloc(collisionWorld->solverBatchStart,
+                                               (capacity + 1) * sizeof(unsigned int));
+    if (collisionWorld->solverEventBatch == NULL || collisionWorld->solverOrder == NULL
+        || collisionWorld->solverBatchStart == NULL) {
+      fprintf(stderr, "Couldn't allocate solver batches\n");
+      exit(1);
+    }
+    collisionWorld->solverCapacity = capacity;
+  }
+  unsigned int* line_batch = collisionWorld->solverLineBatch;
+  unsigned int* event_batch = collisionWorld->solverEventBatch;
+  unsigned int* order = collisionWorld->solverOrder;
+  unsigned int* start = collisionWorld->solverBatchStart;
 
-extern bool quad_tree_flag;
+  // Batches are numbered from 1 here, 0 means the line has had no event yet
+  unsigned int num_batches = 0;
+  for (unsigned int e = 0; e < num_events; e++) {
+    const unsigned int l1 = events[e].l1Id;
+    const unsigned int l2 = events[e].l2Id;
+    const unsigned int b = (line_batch[l1] > line_batch[l2] ? line_batch[l1] : line_batch[l2]) + 1;
+    event_batch[e] = b;
+    line_batch[l1] = b;
+    line_batch[l2] = b;
+    if (b > num_batches) {
+      num_batches = b;
+    }
+  }
+
+  // Stable counting sort of the events by batch, the same as CollisionWorld_groupCandidatePairs
+  memset(start, 0, (num_batches + 1) * sizeof(unsigned int));
+  for (unsigned int e = 0; e < num_events; e++) {
+    start[event_batch[e]]++;
+  }
+  for (unsigned int b = 1; b <= num_batches; b++) {
+    start[b] += start[b - 1];
+  }
+  for (unsigned int e = 0; e < num_events; e++) {
+    order[start[event_batch[e] - 1]++] = e;
+  }
+  for (unsigned int b = num_batches; b > 0; b--) {
+    start[b] = start[b - 1];
+  }
+  start[0] = 0;
+
+  for (unsigned int e = 0; e < num_events; e++) {
+    line_batch[events[e].l1Id] = 0;
+    line_batch[events[e].l2Id] = 0;
+  }
+
+  for (unsigned int b = 0; b < num_batches; b++) {
+    cilk_for (unsigned int k = start[b]; k < start[b + 1]; k++) {
+      const IntersectionEvent* event = &events[order[k]];
+      CollisionWorld_collisionSolver(collisionWorld, event->l1Id, event->l2Id,
+                                     event->intersectionType);
+    }
+  }
+  PHASE_TIMING_COUNT(COUNTER_SOLVER_BATCHES, num_batches);
+}
 
 // The other main simulation loop
 void CollisionWorld_updateLines(CollisionWorld* collisionWorld) {
+  PHASE_TIMING_BEGIN(PHASE_FRAME);
   CollisionWorld_detectIntersection(collisionWorld);
-  CollisionWorld_updatePosition(collisionWorld);
-  CollisionWorld_lineWallCollision(collisionWorld);
+  {
+    PHASE_TIMING_BEGIN(PHASE_ADVANCE);
+    CollisionWorld_advanceLines(collisionWorld);
+    PHASE_TIMING_END(PHASE_ADVANCE);
+  }
+  FrameArena_Reset(&collisionWorld->frameArena);
+  PHASE_TIMING_END(PHASE_FRAME);
+  PHASE_TIMING_END_FRAME();
 }
 
 void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
   assert(collisionWorld);
   assert(collisionWorld->quad_tree);
 
-  IntersectionEventList intersectionEventList = IntersectionEventList_make();
+  IntersectionEventList* intersectionEventList = &collisionWorld->intersectionEventList;
+  IntersectionEventList_clear(intersectionEventList);
+
+  // the cached pairs stand until some line leaves its fattened box
+  const bool refresh_pair_cache = collisionWorld->using_pair_cache
+                                  && !CollisionWorld_pairCacheHolds(collisionWorld);
 
-  if(collisionWorld->using_quad_tree) {
+  PHASE_TIMING_BEGIN(PHASE_BROAD_PHASE_BUILD);
+  if(collisionWorld->using_pair_cache) {
+    if(refresh_pair_cache) {
+      CollisionWorld_fattenBoxes(collisionWorld);
+      if(collisionWorld->broad_phase == BROAD_PHASE_QUAD_TREE) {
+        QuadTree_BuildFromBoxes(collisionWorld->quad_tree, collisionWorld->numOfLines,
+                                collisionWorld->pairCacheMinX, collisionWorld->pairCacheMaxX,
+                                collisionWorld->pairCacheMinY, collisionWorld->pairCacheMaxY);
+        QuadTree_Freeze(collisionWorld->quad_tree);
+      }
+    }
+  }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_QUAD_TREE) {
     // instead of updating the tree we just re-init everytime
     // it is cleared and then filled so that it is filled when referenced outside of
     // this loop (e.g. graphics_stuff.c)
     CollisionWorld_ClearQuadTree(collisionWorld);
     CollisionWorld_FillQuadTree(collisionWorld);
-    for (unsigned int i = 0; i < collisionWorld->numOfLines; ++i) {
-      Line *l1 = collisionWorld->lines[i];
-      SmallList line_ids = QuadTree_QueryLines(collisionWorld->quad_tree, i, collisionWorld->timeStep);
-
-      for(unsigned int j = 0; j < line_ids.num_elements; ++j) {
-        unsigned int id;
-        SmallList_GetAtIndexCopy(&line_ids, j, &id);      
-        Line* l2 = collisionWorld->lines[id];
-        
-	    if(compareLines(l1,l2) < 0) {
-              IntersectionType intersectionType = intersect(l1, l2, collisionWorld->timeStep);
-              if (intersectionType != NO_INTERSECTION) {
-                IntersectionEventList_appendNode(&intersectionEventList, l1, l2,
-                                                 intersectionType);
-                collisionWorld->numLineLineCollisions++;
-              }
-	    }
+    // packed into contiguous leaves for the rest of the frame
+    QuadTree_Freeze(collisionWorld->quad_tree);
+  }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_GRID) {
+    // the grid is cheap to rebin so it is rebuilt from scratch every frame
+    SpatialGrid_Build(collisionWorld->spatial_grid, collisionWorld->numOfLines, collisionWorld->timeStep);
+  }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_SWEEP) {
+    // the sorted list carries over from last frame and is only fixed up
+    SweepAndPrune_Update(collisionWorld->sweep_and_prune, collisionWorld->numOfLines, collisionWorld->timeStep);
+  }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_LINEAR_QUAD_TREE) {
+    LinearQuadTree_Build(collisionWorld->linear_quad_tree, collisionWorld->numOfLines, collisionWorld->timeStep);
+  }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_BVH) {
+    // the tree keeps its shape and is only refit, until it has loosened enough to rebuild
+    Bvh_Update(collisionWorld->bvh, collisionWorld->numOfLines, collisionWorld->timeStep);
+  }
+  PHASE_TIMING_END(PHASE_BROAD_PHASE_BUILD);
+
+  if(collisionWorld->using_pair_cache) {
+    PHASE_TIMING_COUNT(COUNTER_PAIR_CACHE_REFRESHES, refresh_pair_cache);
+    if(refresh_pair_cache) {
+      // pairs of lines whose fattened boxes could overlap, from the quad tree or by checking them all
+      PHASE_TIMING_BEGIN(PHASE_PAIR_WALK);
+      collisionWorld->numCandidatePairs = 0;
+      if(collisionWorld->broad_phase == BROAD_PHASE_QUAD_TREE) {
+        PHASE_TIMING_COUNT(COUNTER_TREE_NODES, collisionWorld->quad_tree->quad_nodes.num_elements);
+        PHASE_TIMING_COUNT(COUNTER_TREE_ELEMENTS,
+                           FreeList_GetNumElements(&collisionWorld->quad_tree->quad_elements));
+        QuadTree_ForEachCandidatePair(collisionWorld->quad_tree, collisionWorld->numOfLines,
+                                      CollisionWorld_addCandidatePair, collisionWorld);
+      }
+      else {
+        CollisionWorld_addOverlappingBoxPairs(collisionWorld);
       }
-      SmallList_Free(&line_ids);
+      CollisionWorld_groupCandidatePairs(collisionWorld);
+      collisionWorld->pairCacheValid = true;
+      PHASE_TIMING_END(PHASE_PAIR_WALK);
     }
   }
-  else {
-    // Test all line-line pairs to see if they will intersect before the
-    // next time step.
-    for (int i = 0; i < collisionWorld->numOfLines; i++) {
-      Line *l1 = collisionWorld->lines[i];
-
-      for (int j = i + 1; j < collisionWorld->numOfLines; j++) {
-        Line *l2 = collisionWorld->lines[j];
-
-        IntersectionType intersectionType =
-            intersect(l1, l2, collisionWorld->timeStep);
-        if (intersectionType != NO_INTERSECTION) {
-          IntersectionEventList_appendNode(&intersectionEventList, l1, l2,
-                                           intersectionType);
-          collisionWorld->numLineLineCollisions++;
-        }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_QUAD_TREE) {
+    PHASE_TIMING_COUNT(COUNTER_TREE_NODES, collisionWorld->quad_tree->quad_nodes.num_elements);
+    PHASE_TIMING_COUNT(COUNTER_TREE_ELEMENTS,
+                       FreeList_GetNumElements(&collisionWorld->quad_tree->quad_elements));
+
+    // each pair of lines sharing a leaf comes out once, grouped by the lower id
+    PHASE_TIMING_BEGIN(PHASE_PAIR_WALK);
+    collisionWorld->numCandidatePairs = 0;
+    QuadTree_ForEachCandidatePair(collisionWorld->quad_tree, collisionWorld->numOfLines,
+                                  CollisionWorld_addCandidatePair, collisionWorld);
+    CollisionWorld_groupCandidatePairs(collisionWorld);
+    PHASE_TIMING_END(PHASE_PAIR_WALK);
+  }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_LINEAR_QUAD_TREE) {
+    PHASE_TIMING_COUNT(COUNTER_TREE_NODES, collisionWorld->linear_quad_tree->num_nodes);
+
+    PHASE_TIMING_BEGIN(PHASE_PAIR_WALK);
+    collisionWorld->numCandidatePairs = 0;
+    LinearQuadTree_ForEachCandidatePair(collisionWorld->linear_quad_tree,
+                                        CollisionWorld_addCandidatePair, collisionWorld);
+    CollisionWorld_groupCandidatePairs(collisionWorld);
+    PHASE_TIMING_END(PHASE_PAIR_WALK);
+  }
+  else if(collisionWorld->broad_phase == BROAD_PHASE_BVH) {
+    PHASE_TIMING_COUNT(COUNTER_TREE_NODES, collisionWorld->bvh->num_nodes);
+
+    PHASE_TIMING_BEGIN(PHASE_PAIR_WALK);
+    collisionWorld->numCandidatePairs = 0;
+    Bvh_ForEachCandidatePair(collisionWorld->bvh, CollisionWorld_addCandidatePair, collisionWorld);
+    CollisionWorld_groupCandidatePairs(collisionWorld);
+    PHASE_TIMING_END(PHASE_PAIR_WALK);
+  }
+
+  PHASE_TIMING_BEGIN(PHASE_NARROW_PHASE);
+
+  if(collisionWorld->using_parallel_detection) {
+    // Each chunk of lines gets its own event list. Chunks are fixed by line index
+    // (not by worker) so stitching them back together in chunk order gives
+    // exactly the list the serial loop would have built.
+    const unsigned int num_chunks = (collisionWorld->numOfLines + DETECTION_CHUNK_SIZE - 1)
+                                    / DETECTION_CHUNK_SIZE;
+    if (num_chunks > collisionWorld->numChunkEventLists) {
+      collisionWorld->chunkEventLists = realloc(collisionWorld->chunkEventLists,
+                                                num_chunks * sizeof(IntersectionEventList));
+      assert(collisionWorld->chunkEventLists);
+      for (unsigned int c = collisionWorld->numChunkEventLists; c < num_chunks; ++c) {
+        collisionWorld->chunkEventLists[c] = IntersectionEventList_make();
       }
+      collisionWorld->numChunkEventLists = num_chunks;
     }
-  }
+    IntersectionEventList* chunk_lists = collisionWorld->chunkEventLists;
 
-  // Sort the intersection event list.
-  IntersectionEventNode* startNode = intersectionEventList.head;
-  while (startNode != NULL) {
-    IntersectionEventNode* minNode = startNode;
-    IntersectionEventNode* curNode = startNode->next;
-    while (curNode != NULL) {
-      if (IntersectionEventNode_compareData(curNode, minNode) < 0) {
-        minNode = curNode;
+    cilk_for (unsigned int c = 0; c < num_chunks; ++c) {
+      IntersectionEventList_clear(&chunk_lists[c]);
+      const unsigned int end = (c + 1) * DETECTION_CHUNK_SIZE < collisionWorld->numOfLines ?
+                               (c + 1) * DETECTION_CHUNK_SIZE : collisionWorld->numOfLines;
+      for (unsigned int i = c * DETECTION_CHUNK_SIZE; i < end; ++i) {
+        CollisionWorld_detectLineIntersections(collisionWorld, i, &chunk_lists[c]);
       }
-      curNode = curNode->next;
     }
-    if (minNode != startNode) {
-      IntersectionEventNode_swapData(minNode, startNode);
+
+    for (unsigned int c = 0; c < num_chunks; ++c) {
+      IntersectionEventList_concat(intersectionEventList, &chunk_lists[c]);
+      collisionWorld->numLineLineCollisions += chunk_lists[c].size;
+    }
+  }
+  else {
+    for (unsigned int i = 0; i < collisionWorld->numOfLines; ++i) {
+      collisionWorld->numLineLineCollisions +=
+          CollisionWorld_detectLineIntersections(collisionWorld, i, intersectionEventList);
     }
-    startNode = startNode->next;
   }
+  PHASE_TIMING_END(PHASE_NARROW_PHASE);
+  PHASE_TIMING_COUNT(COUNTER_EVENTS, intersectionEventList->size);
 
-  // Call the collision solver for each intersection event.
-  IntersectionEventNode* curNode = intersectionEventList.head;
+  // Sort the intersection event list.
+  PHASE_TIMING_BEGIN(PHASE_EVENT_SORT);
+  IntersectionEventList_sort(intersectionEventList);
+  PHASE_TIMING_END(PHASE_EVENT_SORT);
 
-  while (curNode != NULL) {
-    CollisionWorld_collisionSolver(collisionWorld, curNode->l1, curNode->l2,
-                                   curNode->intersectionType);
-    curNode = curNode->next;
+  // Call the collision solver for each intersection event.
+  PHASE_TIMING_BEGIN(PHASE_COLLISION_SOLVER);
+  if(collisionWorld->using_parallel_solver) {
+    CollisionWorld_solveInBatches(collisionWorld, intersectionEventList);
   }
-
-  IntersectionEventList_deleteNodes(&intersectionEventList);
+  else {
+    for (unsigned int e = 0; e < intersectionEventList->size; e++) {
+      IntersectionEvent* event = &intersectionEventList->events[e];
+      CollisionWorld_collisionSolver(collisionWorld, event->l1Id, event->l2Id,
+                                     event->intersectionType);
+    }
+  }
+  PHASE_TIMING_END(PHASE_COLLISION_SOLVER);
 }
 
 
 void CollisionWorld_updatePosition(CollisionWorld* collisionWorld) {
   double t = collisionWorld->timeStep;
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *line = collisionWorld->lines[i];
-    line->p1 = Vec_add(line->p1, Vec_multiply(line->velocity, t));
-    line->p2 = Vec_add(line->p2, Vec_multiply(line->velocity, t));
+  LineStore* lineStore = &collisionWorld->lineStore;
+  for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+    lineStore->p1x[i] += lineStore->vx[i] * t;
+    lineStore->p1y[i] += lineStore->vy[i] * t;
+    lineStore->p2x[i] += lineStore->vx[i] * t;
+    lineStore->p2y[i] += lineStore->vy[i] * t;
+  }
+}
+
+// Moves line i and bounces it off the walls, as CollisionWorld_updatePosition
+// followed by CollisionWorld_lineWallCollision.  Returns 1 if it hit a wall.
+static inline unsigned int CollisionWorld_advanceLine(LineStore* lineStore,
+                                                      const unsigned int i,
+                                                      const double t) {
+  lineStore->p1x[i] += lineStore->vx[i] * t;
+  lineStore->p1y[i] += lineStore->vy[i] * t;
+  lineStore->p2x[i] += lineStore->vx[i] * t;
+  lineStore->p2y[i] += lineStore->vy[i] * t;
+
+  bool collide = false;
+  if ((lineStore->p1x[i] > BOX_XMAX || lineStore->p2x[i] > BOX_XMAX)
+      && (lineStore->vx[i] > 0)) {
+    lineStore->vx[i] = -lineStore->vx[i];
+    collide = true;
+  }
+  if ((lineStore->p1x[i] < BOX_XMIN || lineStore->p2x[i] < BOX_XMIN)
+      && (lineStore->vx[i] < 0)) {
+    lineStore->vx[i] = -lineStore->vx[i];
+    collide = true;
+  }
+  if ((lineStore->p1y[i] > BOX_YMAX || lineStore->p2y[i] > BOX_YMAX)
+      && (lineStore->vy[i] > 0)) {
+    lineStore->vy[i] = -lineStore->vy[i];
+    collide = true;
+  }
+  if ((lineStore->p1y[i] < BOX_YMIN || lineStore->p2y[i] < BOX_YMIN)
+      && (lineStore->vy[i] < 0)) {
+    lineStore->vy[i] = -lineStore->vy[i];
+    collide = true;
+  }
+  return collide;
+}
+
+#ifdef __SSE2__
+
+// CollisionWorld_advanceLine for lines begin .. end - 1, two lines at a time in
+// SSE2 registers.  Written with intrinsics: GCC turns the vector extension
+// version of the masked sign flips back into scalar code.  The lanes do the same
+// multiplies and adds and the same wall tests in the same order (max/min of the
+// two endpoints against a wall is the same test as the two compares), and flip
+// the sign bit like -v does, so they give the same bits as the scalar code.
+// Returns the number of lines that hit a wall.
+static unsigned int CollisionWorld_advanceRange(LineStore* lineStore,
+                                                const unsigned int begin,
+                                                const unsigned int end,
+                                                const double t) {
+  box_dimension* restrict p1x = lineStore->p1x;
+  box_dimension* restrict p1y = lineStore->p1y;
+  box_dimension* restrict p2x = lineStore->p2x;
+  box_dimension* restrict p2y = lineStore->p2y;
+  box_dimension* restrict vxs = lineStore->vx;
+  box_dimension* restrict vys = lineStore->vy;
+  const __m128d time = _mm_set1_pd(t);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d sign_bit = _mm_set1_pd(-0.0);
+  const __m128d x_max = _mm_set1_pd(BOX_XMAX);
+  const __m128d x_min = _mm_set1_pd(BOX_XMIN);
+  const __m128d y_max = _mm_set1_pd(BOX_YMAX);
+  const __m128d y_min = _mm_set1_pd(BOX_YMIN);
+  __m128i collided = _mm_setzero_si128();
+
+  unsigned int i = begin;
+  for (; i + 2 <= end; i += 2) {
+    __m128d x1 = _mm_loadu_pd(&p1x[i]);
+    __m128d y1 = _mm_loadu_pd(&p1y[i]);
+    __m128d x2 = _mm_loadu_pd(&p2x[i]);
+    __m128d y2 = _mm_loadu_pd(&p2y[i]);
+    __m128d vx = _mm_loadu_pd(&vxs[i]);
+    __m128d vy = _mm_loadu_pd(&vys[i]);
+
+    x1 = _mm_add_pd(x1, _mm_mul_pd(vx, time));
+    y1 = _mm_add_pd(y1, _mm_mul_pd(vy, time));
+    x2 = _mm_add_pd(x2, _mm_mul_pd(vx, time));
+    y2 = _mm_add_pd(y2, _mm_mul_pd(vy, time));
+
+    // right, left, top, bottom, each test sees the previous bounces
+    const __m128d max_x = _mm_max_pd(x1, x2);
+    const __m128d min_x = _mm_min_pd(x1, x2);
+    const __m128d max_y = _mm_max_pd(y1, y2);
+    const __m128d min_y = _mm_min_pd(y1, y2);
+    __m128d flip = _mm_and_pd(_mm_cmpgt_pd(max_x, x_max), _mm_cmpgt_pd(vx, zero));
+    vx = _mm_xor_pd(vx, _mm_and_pd(flip, sign_bit));
+    __m128d collide = flip;
+    flip = _mm_and_pd(_mm_cmplt_pd(min_x, x_min), _mm_cmplt_pd(vx, zero));
+    vx = _mm_xor_pd(vx, _mm_and_pd(flip, sign_bit));
+    collide = _mm_or_pd(collide, flip);
+    flip = _mm_and_pd(_mm_cmpgt_pd(max_y, y_max), _mm_cmpgt_pd(vy, zero));
+    vy = _mm_xor_pd(vy, _mm_and_pd(flip, sign_bit));
+    collide = _mm_or_pd(collide, flip);
+    flip = _mm_and_pd(_mm_cmplt_pd(min_y, y_min), _mm_cmplt_pd(vy, zero));
+    vy = _mm_xor_pd(vy, _mm_and_pd(flip, sign_bit));
+    collide = _mm_or_pd(collide, flip);
+    // true lanes are all ones, -1
+    collided = _mm_sub_epi64(collided, _mm_castpd_si128(collide));
+
+    _mm_storeu_pd(&p1x[i], x1);
+    _mm_storeu_pd(&p1y[i], y1);
+    _mm_storeu_pd(&p2x[i], x2);
+    _mm_storeu_pd(&p2y[i], y2);
+    _mm_storeu_pd(&vxs[i], vx);
+    _mm_storeu_pd(&vys[i], vy);
+  }
+
+  long long lane_counts[2];
+  _mm_storeu_si128((__m128i*) lane_counts, collided);
+  unsigned int count = lane_counts[0] + lane_counts[1];
+  for (; i < end; i++) {
+    count += CollisionWorld_advanceLine(lineStore, i, t);
+  }
+  return count;
+}
+
+#else
+
+// CollisionWorld_advanceLine for lines begin .. end - 1.  Returns the number of
+// lines that hit a wall.
+static unsigned int CollisionWorld_advanceRange(LineStore* lineStore,
+                                                const unsigned int begin,
+                                                const unsigned int end,
+                                                const double t) {
+  unsigned int count = 0;
+  for (unsigned int i = begin; i < end; i++) {
+    count += CollisionWorld_advanceLine(lineStore, i, t);
+  }
+  return count;
+}
+
+#endif  // __SSE2__
+
+void CollisionWorld_advanceLines(CollisionWorld* collisionWorld) {
+  LineStore* lineStore = &collisionWorld->lineStore;
+  const double t = collisionWorld->timeStep;
+  const unsigned int num_lines = collisionWorld->numOfLines;
+
+  // Each chunk counts its own wall hits, they are added up after the loop
+  const unsigned int num_chunks = (num_lines + ADVANCE_CHUNK_SIZE - 1) / ADVANCE_CHUNK_SIZE;
+  if (num_chunks > collisionWorld->numAdvanceChunks) {
+    collisionWorld->advanceChunkCounts = realloc(collisionWorld->advanceChunkCounts,
+                                                 num_chunks * sizeof(unsigned int));
+    if (collisionWorld->advanceChunkCounts == NULL) {
+      fprintf(stderr, "Couldn't allocate wall collision counts\n");
+      exit(1);
+    }
+    collisionWorld->numAdvanceChunks = num_chunks;
+  }
+  unsigned int* chunk_counts = collisionWorld->advanceChunkCounts;
+
+  cilk_for (unsigned int c = 0; c < num_chunks; ++c) {
+    const unsigned int end = (c + 1) * ADVANCE_CHUNK_SIZE < num_lines ?
+                             (c + 1) * ADVANCE_CHUNK_SIZE : num_lines;
+    chunk_counts[c] = CollisionWorld_advanceRange(lineStore, c * ADVANCE_CHUNK_SIZE, end, t);
+  }
+
+  for (unsigned int c = 0; c < num_chunks; ++c) {
+    collisionWorld->numLineWallCollisions += chunk_counts[c];
   }
 }
 
 void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld) {
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *line = collisionWorld->lines[i];
+  LineStore* lineStore = &collisionWorld->lineStore;
+  for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
     bool collide = false;
 
     // Right side
-    if ((line->p1.x > BOX_XMAX || line->p2.x > BOX_XMAX)
-        && (line->velocity.x > 0)) {
-      line->velocity.x = -line->velocity.x;
+    if ((lineStore->p1x[i] > BOX_XMAX || lineStore->p2x[i] > BOX_XMAX)
+        && (lineStore->vx[i] > 0)) {
+      lineStore->vx[i] = -lineStore->vx[i];
       collide = true;
     }
     // Left side
-    if ((line->p1.x < BOX_XMIN || line->p2.x < BOX_XMIN)
-        && (line->velocity.x < 0)) {
-      line->velocity.x = -line->velocity.x;
+    if ((lineStore->p1x[i] < BOX_XMIN || lineStore->p2x[i] < BOX_XMIN)
+        && (lineStore->vx[i] < 0)) {
+      lineStore->vx[i] = -lineStore->vx[i];
       collide = true;
     }
     // Top side
-    if ((line->p1.y > BOX_YMAX || line->p2.y > BOX_YMAX)
-        && (line->velocity.y > 0)) {
-      line->velocity.y = -line->velocity.y;
+    if ((lineStore->p1y[i] > BOX_YMAX || lineStore->p2y[i] > BOX_YMAX)
+        && (lineStore->vy[i] > 0)) {
+      lineStore->vy[i] = -lineStore->vy[i];
       collide = true;
     }
     // Bottom side
-    if ((line->p1.y < BOX_YMIN || line->p2.y < BOX_YMIN)
-        && (line->velocity.y < 0)) {
-      line->velocity.y = -line->velocity.y;
+    if ((lineStore->p1y[i] < BOX_YMIN || lineStore->p2y[i] < BOX_YMIN)
+        && (lineStore->vy[i] < 0)) {
+      lineStore->vy[i] = -lineStore->vy[i];
       collide = true;
     }
     // Update total number of collisions.
@@ -171,53 +776,179 @@ void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld) {
 
 // quad_tree stuff
 void CollisionWorld_FillQuadTree(CollisionWorld* collisionWorld) {
-    for(int i = 0; i < collisionWorld->numOfLines; ++i) {
-      QuadTree_Insert(collisionWorld->quad_tree, collisionWorld->lines[i]->id, collisionWorld->timeStep);
-    }
+    QuadTree_Build(collisionWorld->quad_tree, collisionWorld->numOfLines, collisionWorld->timeStep);
 }
 
 void CollisionWorld_ClearQuadTree(CollisionWorld* collisionWorld) {
     QuadTree_Clear(collisionWorld->quad_tree);
 }
 
-CollisionWorld* CollisionWorld_new(const unsigned int capacity, bool quad_tree_flag) {
+CollisionWorld* CollisionWorld_new(const unsigned int capacity, BroadPhase broad_phase) {
   assert(capacity > 0);
 
+  LineStore lineStore;
+  if (!LineStore_init(&lineStore, capacity)) {
+    return NULL;
+  }
+  return CollisionWorld_newWithLines(&lineStore, 0, broad_phase);
+}
+
+CollisionWorld* CollisionWorld_newWithLines(LineStore* lineStore,
+                                            const unsigned int numOfLines,
+                                            BroadPhase broad_phase) {
+  assert(lineStore->capacity > 0);
+  assert(numOfLines <= lineStore->capacity);
+  const unsigned int capacity = lineStore->capacity;
+
   CollisionWorld* collisionWorld = malloc(sizeof(CollisionWorld));
   if (collisionWorld == NULL) {
+    LineStore_free(lineStore);
     return NULL;
   }
 
   collisionWorld->numLineWallCollisions = 0;
   collisionWorld->numLineLineCollisions = 0;
   collisionWorld->timeStep = 0.5;
-  collisionWorld->lines = malloc(capacity * sizeof(Line*));
-  collisionWorld->numOfLines = 0;
-  collisionWorld->using_quad_tree = quad_tree_flag;
+  collisionWorld->lineStore = *lineStore;
+  collisionWorld->numOfLines = numOfLines;
+  collisionWorld->broad_phase = broad_phase;
+  collisionWorld->using_parallel_detection = false;
+  collisionWorld->using_parallel_solver = false;
+  collisionWorld->using_pair_cache = false;
+  collisionWorld->intersectionEventList = IntersectionEventList_make();
+  collisionWorld->chunkEventLists = NULL;
+  collisionWorld->numChunkEventLists = 0;
+  collisionWorld->solverLineBatch = NULL;
+  collisionWorld->solverEventBatch = NULL;
+  collisionWorld->solverOrder = NULL;
+  collisionWorld->solverBatchStart = NULL;
+  collisionWorld->solverCapacity = 0;
+  collisionWorld->advanceChunkCounts = NULL;
+  collisionWorld->numAdvanceChunks = 0;
+  collisionWorld->pairCacheMinX = NULL;
+  collisionWorld->pairCacheMaxX = NULL;
+  collisionWorld->pairCacheMinY = NULL;
+  collisionWorld->pairCacheMaxY = NULL;
+  collisionWorld->pairCacheValid = false;
+  collisionWorld->candidatePairs = NULL;
+  collisionWorld->numCandidatePairs = 0;
+  collisionWorld->candidatePairsCapacity = 0;
+  collisionWorld->candidateIds = NULL;
+  collisionWorld->candidateStart = malloc((capacity + 1) * sizeof(unsigned int));
+  if (collisionWorld->candidateStart == NULL) {
+    IntersectionEventList_free(&collisionWorld->intersectionEventList);
+    LineStore_free(&collisionWorld->lineStore);
+    free(collisionWorld);
+    return NULL;
+  }
+
+  // Grows itself if a frame needs more
+  FrameArena_Init(&collisionWorld->frameArena, FRAME_ARENA_INITIAL_BYTES);
 
   // QUAD_TREE
   collisionWorld->quad_tree = malloc(sizeof(QuadTree));
   if(collisionWorld->quad_tree == NULL) {
-    if(collisionWorld->lines) {
-        free(collisionWorld->lines);
-    }
+    FrameArena_Free(&collisionWorld->frameArena);
+    free(collisionWorld->candidateStart);
+    LineStore_free(&collisionWorld->lineStore);
     free(collisionWorld);
     return NULL;
   }
   const int max_depth = 10;
   const int max_elements = 10;
-  QuadTree_Init(collisionWorld->quad_tree, collisionWorld->lines, WINDOW_WIDTH, WINDOW_HEIGHT, max_depth, max_elements);
+  QuadTree_Init(collisionWorld->quad_tree, &collisionWorld->lineStore, &collisionWorld->frameArena, WINDOW_WIDTH, WINDOW_HEIGHT, max_depth, max_elements);
+
+  // SPATIAL_GRID
+  collisionWorld->spatial_grid = malloc(sizeof(SpatialGrid));
+  if(collisionWorld->spatial_grid == NULL) {
+    QuadTree_Free(collisionWorld->quad_tree);
+    free(collisionWorld->quad_tree);
+    FrameArena_Free(&collisionWorld->frameArena);
+    free(collisionWorld->candidateStart);
+    LineStore_free(&collisionWorld->lineStore);
+    free(collisionWorld);
+    return NULL;
+  }
+  SpatialGrid_Init(collisionWorld->spatial_grid, &collisionWorld->lineStore);
+
+  // SWEEP_AND_PRUNE
+  collisionWorld->sweep_and_prune = malloc(sizeof(SweepAndPrune));
+  if(collisionWorld->sweep_and_prune == NULL) {
+    free(collisionWorld->spatial_grid);
+    QuadTree_Free(collisionWorld->quad_tree);
+    free(collisionWorld->quad_tree);
+    FrameArena_Free(&collisionWorld->frameArena);
+    free(collisionWorld->candidateStart);
+    LineStore_free(&collisionWorld->lineStore);
+    free(collisionWorld);
+    return NULL;
+  }
+  SweepAndPrune_Init(collisionWorld->sweep_and_prune, &collisionWorld->lineStore);
+
+  // LINEAR_QUAD_TREE
+  collisionWorld->linear_quad_tree = malloc(sizeof(LinearQuadTree));
+  if(collisionWorld->linear_quad_tree == NULL) {
+    free(collisionWorld->sweep_and_prune);
+    free(collisionWorld->spatial_grid);
+    QuadTree_Free(collisionWorld->quad_tree);
+    free(collisionWorld->quad_tree);
+    FrameArena_Free(&collisionWorld->frameArena);
+    free(collisionWorld->candidateStart);
+    LineStore_free(&collisionWorld->lineStore);
+    free(collisionWorld);
+    return NULL;
+  }
+  LinearQuadTree_Init(collisionWorld->linear_quad_tree, &collisionWorld->lineStore);
+
+  // BVH
+  collisionWorld->bvh = malloc(sizeof(Bvh));
+  if(collisionWorld->bvh == NULL) {
+    free(collisionWorld->linear_quad_tree);
+    free(collisionWorld->sweep_and_prune);
+    free(collisionWorld->spatial_grid);
+    QuadTree_Free(collisionWorld->quad_tree);
+    free(collisionWorld->quad_tree);
+    FrameArena_Free(&collisionWorld->frameArena);
+    free(collisionWorld->candidateStart);
+    LineStore_free(&collisionWorld->lineStore);
+    free(collisionWorld);
+    return NULL;
+  }
+  Bvh_Init(collisionWorld->bvh, &collisionWorld->lineStore);
 
   return collisionWorld;
 }
 
 void CollisionWorld_delete(CollisionWorld* collisionWorld) {
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    free(collisionWorld->lines[i]);
+  LineStore_free(&collisionWorld->lineStore);
+  IntersectionEventList_free(&collisionWorld->intersectionEventList);
+  for (unsigned int c = 0; c < collisionWorld->numChunkEventLists; c++) {
+    IntersectionEventList_free(&collisionWorld->chunkEventLists[c]);
   }
-  free(collisionWorld->lines);
+  free(collisionWorld->chunkEventLists);
+  free(collisionWorld->solverLineBatch);
+  free(collisionWorld->solverEventBatch);
+  free(collisionWorld->solverOrder);
+  free(collisionWorld->solverBatchStart);
+  free(collisionWorld->advanceChunkCounts);
+  free(collisionWorld->pairCacheMinX);
+  free(collisionWorld->pairCacheMaxX);
+  free(collisionWorld->pairCacheMinY);
+  free(collisionWorld->pairCacheMaxY);
+  free(collisionWorld->candidatePairs);
+  free(collisionWorld->candidateStart);
+  free(collisionWorld->candidateIds);
   QuadTree_Free(collisionWorld->quad_tree);
   free(collisionWorld->quad_tree);
+  FrameArena_Free(&collisionWorld->frameArena);
+  SpatialGrid_Free(collisionWorld->spatial_grid);
+  free(collisionWorld->spatial_grid);
+  SweepAndPrune_Free(collisionWorld->sweep_and_prune);
+  free(collisionWorld->sweep_and_prune);
+  LinearQuadTree_Free(collisionWorld->linear_quad_tree);
+  free(collisionWorld->linear_quad_tree);
+  Bvh_Free(collisionWorld->bvh);
+  free(collisionWorld->bvh);
   free(collisionWorld);
 }
 
@@ -225,17 +956,22 @@ unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld) {
   return collisionWorld->numOfLines;
 }
 
-void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line) {
-  collisionWorld->lines[collisionWorld->numOfLines] = line;
+void CollisionWorld_addLine(CollisionWorld* collisionWorld, const Line *line) {
+  assert(line->id == collisionWorld->numOfLines);
+  LineStore_setLine(&collisionWorld->lineStore, line);
   collisionWorld->numOfLines++;
+  // the cached pairs don't know about the new line
+  collisionWorld->pairCacheValid = false;
 }
 
-Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
-                             const unsigned int index) {
-  if (index >= collisionWorld->numOfLines) {
-    return NULL;
-  }
-  return collisionWorld->lines[index];
+void CollisionWorld_computeLineShapes(CollisionWorld* collisionWorld) {
+  LineStore_computeShapes(&collisionWorld->lineStore, collisionWorld->numOfLines);
+}
+
+Line CollisionWorld_getLine(CollisionWorld* collisionWorld,
+                            const unsigned int index) {
+  assert(index < collisionWorld->numOfLines);
+  return LineStore_getLine(&collisionWorld->lineStore, index);
 }
 
 
@@ -250,14 +986,37 @@ unsigned int CollisionWorld_getNumLineLineCollisions(
   return collisionWorld->numLineLineCollisions;
 }
 
+// Vec2_length(a) < Vec2_length(b) from the squared lengths.  Only when these are
+// within IS_SHORTER_MIN_RATIO of each other could rounding in them or in hypot
+// tell the two apart differently, and hypot is asked after all.
+static inline bool CollisionWorld_isShorter(const Vec a, const Vec b) {
+  const double lengthA = a.x * a.x + a.y * a.y;
+  const double lengthB = b.x * b.x + b.y * b.y;
+  if (lengthA < lengthB * (1 - IS_SHORTER_MIN_RATIO)) {
+    return true;
+  }
+  if (lengthB < lengthA * (1 - IS_SHORTER_MIN_RATIO)) {
+    return false;
+  }
+  return Vec2_length(a) < Vec2_length(b);
+}
+
 void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
-                                    Line *l1, Line *l2,
+                                    const unsigned int l1Id,
+                                    const unsigned int l2Id,
                                     IntersectionType intersectionType) {
-  assert(compareLines(l1, l2) < 0);
+  assert(l1Id < l2Id);
   assert(intersectionType == L1_WITH_L2
          || intersectionType == L2_WITH_L1
          || intersectionType == ALREADY_INTERSECTED);
 
+  // Work on copies of the lines and write the new velocities back at the end.
+  LineStore* lineStore = &collisionWorld->lineStore;
+  Line line1 = LineStore_getLine(lineStore, l1Id);
+  Line line2 = LineStore_getLine(lineStore, l2Id);
+  Line *l1 = &line1;
+  Line *l2 = &line2;
+
   // Despite our efforts to determine whether lines will intersect ahead
   // of time (and to modify their velocities appropriately), our
   // simplified model can sometimes cause lines to intersect.  In such a
@@ -267,47 +1026,40 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
   if (intersectionType == ALREADY_INTERSECTED) {
     Vec p = getIntersectionPoint(l1->p1, l1->p2, l2->p1, l2->p2);
 
-    if (Vec_length(Vec_subtract(l1->p1, p))
-        < Vec_length(Vec_subtract(l1->p2, p))) {
-      l1->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l1->p2, p)),
-                                  Vec_length(l1->velocity));
+    if (CollisionWorld_isShorter(Vec2_subtract(l1->p1, p), Vec2_subtract(l1->p2, p))) {
+      l1->velocity = Vec2_multiply(Vec2_normalize(Vec2_subtract(l1->p2, p)),
+                                   Vec2_length(l1->velocity));
     } else {
-      l1->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l1->p1, p)),
-                                  Vec_length(l1->velocity));
+      l1->velocity = Vec2_multiply(Vec2_normalize(Vec2_subtract(l1->p1, p)),
+                                   Vec2_length(l1->velocity));
     }
-    if (Vec_length(Vec_subtract(l2->p1, p))
-        < Vec_length(Vec_subtract(l2->p2, p))) {
-      l2->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l2->p2, p)),
-                                  Vec_length(l2->velocity));
+    if (CollisionWorld_isShorter(Vec2_subtract(l2->p1, p), Vec2_subtract(l2->p2, p))) {
+      l2->velocity = Vec2_multiply(Vec2_normalize(Vec2_subtract(l2->p2, p)),
+                                   Vec2_length(l2->velocity));
     } else {
-      l2->velocity = Vec_multiply(Vec_normalize(Vec_subtract(l2->p1, p)),
-                                  Vec_length(l2->velocity));
+      l2->velocity = Vec2_multiply(Vec2_normalize(Vec2_subtract(l2->p1, p)),
+                                   Vec2_length(l2->velocity));
     }
+    LineStore_setVelocity(lineStore, l1Id, l1->velocity);
+    LineStore_setVelocity(lineStore, l2Id, l2->velocity);
     return;
   }
 
-  // Compute the collision face/normal vectors.
-  Vec face;
-  Vec normal;
-  if (intersectionType == L1_WITH_L2) {
-    Vec v = Vec_makeFromLine(*l2);
-    face = Vec_normalize(v);
-  } else {
-    Vec v = Vec_makeFromLine(*l1);
-    face = Vec_normalize(v);
-  }
-  normal = Vec_orthogonal(face);
+  // The collision face/normal vectors, from the line that was hit.
+  const unsigned int faceId = intersectionType == L1_WITH_L2 ? l2Id : l1Id;
+  const Vec face = LineStore_getFace(lineStore, faceId);
+  const Vec normal = LineStore_getNormal(lineStore, faceId);
 
   // Obtain each line's velocity components with respect to the collision
   // face/normal vectors.
-  double v1Face = Vec_dotProduct(l1->velocity, face);
-  double v2Face = Vec_dotProduct(l2->velocity, face);
-  double v1Normal = Vec_dotProduct(l1->velocity, normal);
-  double v2Normal = Vec_dotProduct(l2->velocity, normal);
+  double v1Face = Vec2_dotProduct(l1->velocity, face);
+  double v2Face = Vec2_dotProduct(l2->velocity, face);
+  double v1Normal = Vec2_dotProduct(l1->velocity, normal);
+  double v2Normal = Vec2_dotProduct(l2->velocity, normal);
 
-  // Compute the mass of each line (we simply use its length).
-  double m1 = Vec_length(Vec_subtract(l1->p1, l1->p2));
-  double m2 = Vec_length(Vec_subtract(l2->p1, l2->p2));
+  // The mass of each line (we simply use its length).
+  double m1 = lineStore->length[l1Id];
+  double m2 = lineStore->length[l2Id];
 
   // Perform the collision calculation (computes the new velocities along
   // the direction normal to the collision face such that momentum and
@@ -318,10 +1070,12 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
       + ((m2 - m1) / (m2 + m1)) * v2Normal;
 
   // Combine the resulting velocities.
-  l1->velocity = Vec_add(Vec_multiply(normal, newV1Normal),
-                         Vec_multiply(face, v1Face));
-  l2->velocity = Vec_add(Vec_multiply(normal, newV2Normal),
-                         Vec_multiply(face, v2Face));
+  l1->velocity = Vec2_add(Vec2_multiply(normal, newV1Normal),
+                          Vec2_multiply(face, v1Face));
+  l2->velocity = Vec2_add(Vec2_multiply(normal, newV2Normal),
+                          Vec2_multiply(face, v2Face));
 
+  LineStore_setVelocity(lineStore, l1Id, l1->velocity);
+  LineStore_setVelocity(lineStore, l2Id, l2->velocity);
   return;
 }
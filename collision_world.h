@@ -25,20 +25,85 @@
 #define COLLISIONWORLD_H_
 
 #include "./line.h"
+#include "./line_store.h"
 #include "./intersection_detection.h"
+#include "./intersection_event_list.h"
 #include "./quad_tree/quad_tree.h"
+#include "./quad_tree/linear_quad_tree.h"
+#include "./spatial_grid/spatial_grid.h"
+#include "./sweep_and_prune/sweep_and_prune.h"
+#include "./bvh/bvh.h"
+
+// How candidate pairs are found before the exact intersection test
+typedef enum {
+  BROAD_PHASE_N2,         // every pair of lines
+  BROAD_PHASE_QUAD_TREE,  // lines sharing a quad tree leaf
+  BROAD_PHASE_GRID,       // lines sharing a uniform grid cell
+  BROAD_PHASE_SWEEP,      // lines whose boxes overlap, found by sort and sweep on x
+  BROAD_PHASE_LINEAR_QUAD_TREE,  // lines whose boxes overlap, found in a Morton ordered quad tree
+  BROAD_PHASE_BVH         // lines whose boxes overlap, found in a refit bounding volume hierarchy
+} BroadPhase;
 
 struct CollisionWorld {
   // Time step used for simulation
   double timeStep;
 
-  // Container that holds all the lines as an array of Line* lines.
-  // This CollisionWorld owns the Line* lines.
-  Line** lines;
+  // Holds all the lines as parallel arrays indexed by line ID.
+  LineStore lineStore;
   QuadTree* quad_tree;
-  bool using_quad_tree;
+  // Scratch memory for the quad tree's temporary lists, reset after every frame.
+  FrameArena frameArena;
+  SpatialGrid* spatial_grid;
+  SweepAndPrune* sweep_and_prune;
+  LinearQuadTree* linear_quad_tree;
+  Bvh* bvh;
+  BroadPhase broad_phase;
+  // Run the per-line query and intersection tests in parallel (cilk_for)
+  bool using_parallel_detection;
+  // Run the collision solver in parallel over batches of events that share no line
+  bool using_parallel_solver;
+  // Keep the candidate pairs between frames (Verlet list) until a line leaves its
+  // fattened box, see CollisionWorld_pairCacheHolds, CollisionWorld_fattenBoxes
+  // and the refresh branch of CollisionWorld_detectIntersection
+  bool using_pair_cache;
   unsigned int numOfLines;
 
+  // Pairs from the quad tree (linear quad tree, bvh) pair walk, (l1Id, l2Id) interleaved with l1Id < l2Id.
+  // They are then grouped by l1Id: the candidates of line i are
+  // candidateIds[candidateStart[i]] .. candidateIds[candidateStart[i + 1] - 1]
+  unsigned int* candidatePairs;
+  unsigned int numCandidatePairs;
+  unsigned int candidatePairsCapacity;
+  unsigned int* candidateStart;
+  unsigned int* candidateIds;
+
+  // Pair cache: the box (box coordinates) each line's swept box has to stay inside for
+  // the cached candidates in candidateStart/candidateIds to hold.  Allocated on first use.
+  double* pairCacheMinX;
+  double* pairCacheMaxX;
+  double* pairCacheMinY;
+  double* pairCacheMaxY;
+  bool pairCacheValid;
+
+  // Events found each frame.  Kept between frames so their memory is reused.
+  IntersectionEventList intersectionEventList;
+  // One list per chunk of lines for parallel detection, grown as needed.
+  IntersectionEventList* chunkEventLists;
+  unsigned int numChunkEventLists;
+
+  // Batches for the parallel solver, see CollisionWorld_solveInBatches.
+  // solverLineBatch holds the batch of each line's latest event (0 between frames),
+  // the events of batch b are solverOrder[solverBatchStart[b]] .. solverOrder[solverBatchStart[b + 1] - 1]
+  unsigned int* solverLineBatch;
+  unsigned int* solverEventBatch;
+  unsigned int* solverOrder;
+  unsigned int* solverBatchStart;
+  unsigned int solverCapacity;
+
+  // Wall hits of each chunk of lines in CollisionWorld_advanceLines, grown as needed.
+  unsigned int* advanceChunkCounts;
+  unsigned int numAdvanceChunks;
+
   // Record the total number of line-wall collisions.
   unsigned int numLineWallCollisions;
 
@@ -48,16 +113,24 @@ struct CollisionWorld {
 typedef struct CollisionWorld CollisionWorld;
 
 // init  and free
-CollisionWorld* CollisionWorld_new(const unsigned int capacity, bool quad_tree_flag);
+CollisionWorld* CollisionWorld_new(const unsigned int capacity, BroadPhase broad_phase);
+// Takes over a store that already holds numOfLines lines (e.g. a mapped scene
+// file).  The store is freed with the world, or right away if this fails.
+CollisionWorld* CollisionWorld_newWithLines(LineStore* lineStore,
+                                            const unsigned int numOfLines,
+                                            BroadPhase broad_phase);
 void CollisionWorld_delete(CollisionWorld* collisionWorld);
 
 
-// Add a line into the box.  Must be under capacity.
-// This CollisionWorld becomes owner of the Line* line.
-void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line);
-// Get a line from box.
-Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
-                             const unsigned int index);
+// Add a line into the box.  Must be under capacity and lines must be added
+// in ID order starting from 0.  The line is copied into the box.
+void CollisionWorld_addLine(CollisionWorld* collisionWorld, const Line *line);
+// Works out each line's fixed shape (direction, length, face and normal) once
+// all lines are in.  Must be called before the first frame.
+void CollisionWorld_computeLineShapes(CollisionWorld* collisionWorld);
+// Get a copy of a line from box.
+Line CollisionWorld_getLine(CollisionWorld* collisionWorld,
+                            const unsigned int index);
 // Return the total number of lines in the box.
 unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld);
 
@@ -74,16 +147,21 @@ unsigned int CollisionWorld_getNumLineLineCollisions(
 
 // Update lines' situation in the box.
 void CollisionWorld_updateLines(CollisionWorld* collisionWorld);
+// Move the lines and bounce them off the walls in one pass, in parallel chunks
+// of vector lanes.  Same result as CollisionWorld_updatePosition followed by
+// CollisionWorld_lineWallCollision, which updateLines no longer calls.
+void CollisionWorld_advanceLines(CollisionWorld* collisionWorld);
 // Update position of lines.
 void CollisionWorld_updatePosition(CollisionWorld* collisionWorld);
 // Handle line-wall collision.
 void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld);
 // Detect line-line intersection.
 void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld);
-// Update the two lines based on their intersection event.
-// Precondition: compareLines(l1, l2) < 0 must be true.
-void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld, Line *l1,
-                                    Line *l2,
+// Update the two lines, given by ID, based on their intersection event.
+// Precondition: l1Id < l2Id must be true.
+void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
+                                    const unsigned int l1Id,
+                                    const unsigned int l2Id,
                                     IntersectionType intersectionType);
 
 // quad_tree stuff
@@ -99,7 +99,8 @@ static void drawLineSegments(Display *display, Drawable drawable) {
   int red_segments_count = 0;
   int gray_segments_count = 0;
   for (unsigned int i = 0; i < nsegments; i++) {
-    line = LineDemo_getLine(gLineDemo, i);
+    Line current = LineDemo_getLine(gLineDemo, i);
+    line = &current;
 
     // Convert box coordinates to window coordinates.
     boxToWindow(&px1, &py1, line->p1.x, line->p1.y);
@@ -140,7 +141,7 @@ static void drawLineSegments(Display *display, Drawable drawable) {
   if(draw_quad_tree) {
     XDrawSegments(display, drawable, green, quad_segments, quad_segments_count);
   }
-  if(gLineDemo->collisionWorld->using_quad_tree) {
+  if(gLineDemo->collisionWorld->broad_phase == BROAD_PHASE_QUAD_TREE) {
     XDrawArc(display, drawable, red, x_root, y_root, diameter, diameter, 0, 360*64);
   }
 
@@ -178,11 +179,11 @@ static void checkEvent() {
 	      // toggles use of quad_tree for collision detection
 	      case 53:
           {
-            if(gLineDemo->collisionWorld->using_quad_tree) {
-	          gLineDemo->collisionWorld->using_quad_tree = false;
+            if(gLineDemo->collisionWorld->broad_phase == BROAD_PHASE_QUAD_TREE) {
+	          gLineDemo->collisionWorld->broad_phase = BROAD_PHASE_N2;
 	        }
 	        else {
-	          gLineDemo->collisionWorld->using_quad_tree = true;
+	          gLineDemo->collisionWorld->broad_phase = BROAD_PHASE_QUAD_TREE;
 	        }
 	      } break;
 
@@ -23,10 +23,65 @@
 #include "./intersection_detection.h"
 
 #include <assert.h>
+#include <math.h>
 
 #include "./line.h"
 #include "./vec.h"
 
+// angleSign() trusts the cross product once the sine of the angle between the
+// vectors is above this, far beyond the rounding of atan2 or of the products.
+#define ANGLE_SIGN_MIN_SINE 1e-9
+
+// atan2 of a non-zero vector on an axis: the exact values C99 gives it (+-0,
+// +-pi/2 or +-pi, the sign following y's even when y is zero).
+static inline double axisArgument(Vec v) {
+  if (v.y == 0) {
+    return v.x > 0 ? v.y : copysign(M_PI, v.y);
+  }
+  return copysign(M_PI_2, v.y);
+}
+
+// Which half of atan2's range a non-zero vector's argument is in: 1 for
+// (0, pi], -1 for [-pi, 0), 0 for the +-0 of the positive x axis.
+static inline int argumentHalf(Vec v) {
+  if (v.y != 0) {
+    return v.y > 0 ? 1 : -1;
+  }
+  if (v.x > 0) {
+    return 0;
+  }
+  return signbit(v.y) ? -1 : 1;
+}
+
+// The sign of Vec_angle(v1, v2) = atan2(v1) - atan2(v2) without the atan2
+// calls in most cases.  Vectors on the axes have exact arguments.  Otherwise
+// an argument in the upper half is above one in the lower half, and within a
+// half (plus the positive x axis) arguments are less than pi apart and grow
+// counterclockwise, that is with the sign of the cross product of v2 and v1.
+// When the two atan2 could round to the same value they are asked after all.
+static inline int angleSign(Vec v1, Vec v2) {
+  const bool zero1 = v1.x == 0 && v1.y == 0;
+  const bool zero2 = v2.x == 0 && v2.y == 0;
+  if (!zero1 && !zero2) {
+    if ((v1.x == 0 || v1.y == 0) && (v2.x == 0 || v2.y == 0)) {
+      const double angle = axisArgument(v1) - axisArgument(v2);
+      return (angle > 0) - (angle < 0);
+    }
+    const int half1 = argumentHalf(v1);
+    const int half2 = argumentHalf(v2);
+    if (half1 != 0 && half2 != 0 && half1 != half2) {
+      return half1;
+    }
+    const double cross = v2.x * v1.y - v2.y * v1.x;
+    const double squaredLengths = (v1.x * v1.x + v1.y * v1.y) * (v2.x * v2.x + v2.y * v2.y);
+    if (cross * cross > ANGLE_SIGN_MIN_SINE * ANGLE_SIGN_MIN_SINE * squaredLengths) {
+      return cross > 0 ? 1 : -1;
+    }
+  }
+  const double angle = Vec_angle(v1, v2);
+  return (angle > 0) - (angle < 0);
+}
+
 // Detect if lines l1 and l2 will intersect between now and the next time step.
 IntersectionType intersect(Line *l1, Line *l2, double time) {
   assert(compareLines(l1, l2) < 0);
@@ -34,15 +89,15 @@ IntersectionType intersect(Line *l1, Line *l2, double time) {
   Vec velocity;
   Vec p1;
   Vec p2;
-  Vec v1 = Vec_makeFromLine(*l1);
-  Vec v2 = Vec_makeFromLine(*l2);
+  Vec v1 = Vec2_subtract(l1->p1, l1->p2);
+  Vec v2 = Vec2_subtract(l2->p1, l2->p2);
 
   // Get relative velocity.
-  velocity = Vec_subtract(l2->velocity, l1->velocity);
+  velocity = Vec2_subtract(l2->velocity, l1->velocity);
 
   // Get the parallelogram.
-  p1 = Vec_add(l2->p1, Vec_multiply(velocity, time));
-  p2 = Vec_add(l2->p2, Vec_multiply(velocity, time));
+  p1 = Vec2_add(l2->p1, Vec2_multiply(velocity, time));
+  p2 = Vec2_add(l2->p2, Vec2_multiply(velocity, time));
 
   int num_line_intersections = 0;
   bool top_intersected = false;
@@ -76,7 +131,7 @@ IntersectionType intersect(Line *l1, Line *l2, double time) {
     return NO_INTERSECTION;
   }
 
-  double angle = Vec_angle(v1, v2);
+  const int angle = angleSign(v1, v2);
 
   if (top_intersected) {
     if (angle < 0) {
@@ -97,6 +152,188 @@ IntersectionType intersect(Line *l1, Line *l2, double time) {
   return L1_WITH_L2;
 }
 
+// Vector lanes for intersectBatch.  GCC/clang vector extensions are lowered to
+// AVX or SSE2 instructions depending on INTERSECT_LANES.  The arithmetic is
+// the same sequence of multiplies and subtracts as the scalar direction(), so
+// as long as the build doesn't turn on FMA contraction the lanes compute the
+// same bits.
+typedef double LaneDouble __attribute__((vector_size(INTERSECT_LANES * sizeof(double))));
+typedef long long LaneMask __attribute__((vector_size(INTERSECT_LANES * sizeof(long long))));
+
+static inline LaneDouble broadcast(double x) {
+  LaneDouble v;
+  for (int k = 0; k < INTERSECT_LANES; k++) {
+    v[k] = x;
+  }
+  return v;
+}
+
+// Lane version of direction().
+static inline LaneDouble directionLanes(LaneDouble pix, LaneDouble piy,
+                                        LaneDouble pjx, LaneDouble pjy,
+                                        LaneDouble pkx, LaneDouble pky) {
+  return (pkx - pix) * (pjy - piy) - (pjx - pix) * (pky - piy);
+}
+
+// Lane version of onSegment().
+static inline LaneMask onSegmentLanes(LaneDouble pix, LaneDouble piy,
+                                      LaneDouble pjx, LaneDouble pjy,
+                                      LaneDouble pkx, LaneDouble pky) {
+  return (((pix <= pkx) & (pkx <= pjx)) | ((pjx <= pkx) & (pkx <= pix)))
+      & (((piy <= pky) & (pky <= pjy)) | ((pjy <= pky) & (pky <= piy)));
+}
+
+// Lane version of intersectLines().
+static inline LaneMask intersectLinesLanes(LaneDouble p1x, LaneDouble p1y,
+                                           LaneDouble p2x, LaneDouble p2y,
+                                           LaneDouble p3x, LaneDouble p3y,
+                                           LaneDouble p4x, LaneDouble p4y) {
+  const LaneDouble zero = broadcast(0);
+  LaneDouble d1 = directionLanes(p3x, p3y, p4x, p4y, p1x, p1y);
+  LaneDouble d2 = directionLanes(p3x, p3y, p4x, p4y, p2x, p2y);
+  LaneDouble d3 = directionLanes(p1x, p1y, p2x, p2y, p3x, p3y);
+  LaneDouble d4 = directionLanes(p1x, p1y, p2x, p2y, p4x, p4y);
+
+  LaneMask straddle = (((d1 > zero) & (d2 < zero)) | ((d1 < zero) & (d2 > zero)))
+      & (((d3 > zero) & (d4 < zero)) | ((d3 < zero) & (d4 > zero)));
+  return straddle
+      | ((d1 == zero) & onSegmentLanes(p3x, p3y, p4x, p4y, p1x, p1y))
+      | ((d2 == zero) & onSegmentLanes(p3x, p3y, p4x, p4y, p2x, p2y))
+      | ((d3 == zero) & onSegmentLanes(p1x, p1y, p2x, p2y, p3x, p3y))
+      | ((d4 == zero) & onSegmentLanes(p1x, p1y, p2x, p2y, p4x, p4y));
+}
+
+// Lane version of pointInParallelogram().
+static inline LaneMask pointInParallelogramLanes(
+    LaneDouble px, LaneDouble py, LaneDouble p1x, LaneDouble p1y,
+    LaneDouble p2x, LaneDouble p2y, LaneDouble p3x, LaneDouble p3y,
+    LaneDouble p4x, LaneDouble p4y) {
+  const LaneDouble zero = broadcast(0);
+  LaneDouble d1 = directionLanes(p1x, p1y, p2x, p2y, px, py);
+  LaneDouble d2 = directionLanes(p3x, p3y, p4x, p4y, px, py);
+  LaneDouble d3 = directionLanes(p1x, p1y, p3x, p3y, px, py);
+  LaneDouble d4 = directionLanes(p2x, p2y, p4x, p4y, px, py);
+
+  return (((d1 > zero) & (d2 < zero)) | ((d1 < zero) & (d2 > zero)))
+      & (((d3 > zero) & (d4 < zero)) | ((d3 < zero) & (d4 > zero)));
+}
+
+void intersectBatch(const Line *l1, const LineStore *lineStore,
+                    const unsigned int *l2Ids, const unsigned int numLines,
+                    double time, IntersectionType *results) {
+  const LaneDouble a1x = broadcast(l1->p1.x);
+  const LaneDouble a1y = broadcast(l1->p1.y);
+  const LaneDouble a2x = broadcast(l1->p2.x);
+  const LaneDouble a2y = broadcast(l1->p2.y);
+  const LaneDouble v1x = broadcast(l1->velocity.x);
+  const LaneDouble v1y = broadcast(l1->velocity.y);
+  const LaneDouble t = broadcast(time);
+
+  for (unsigned int k = 0; k < numLines; k += INTERSECT_LANES) {
+    // Gather the next candidates into lanes, padding the last group by
+    // repeating the final candidate.
+    LaneDouble b1x, b1y, b2x, b2y, v2x, v2y;
+    for (int lane = 0; lane < INTERSECT_LANES; lane++) {
+      const unsigned int index = k + lane < numLines ? k + lane : numLines - 1;
+      const unsigned int id = l2Ids[index];
+      assert(l1->id < id);
+      b1x[lane] = lineStore->p1x[id];
+      b1y[lane] = lineStore->p1y[id];
+      b2x[lane] = lineStore->p2x[id];
+      b2y[lane] = lineStore->p2y[id];
+      v2x[lane] = lineStore->vx[id];
+      v2y[lane] = lineStore->vy[id];
+    }
+
+    // Relative velocity and the parallelogram, as in intersect().
+    LaneDouble vx = v2x - v1x;
+    LaneDouble vy = v2y - v1y;
+    LaneDouble q1x = b1x + vx * t;
+    LaneDouble q1y = b1y + vy * t;
+    LaneDouble q2x = b2x + vx * t;
+    LaneDouble q2y = b2y + vy * t;
+
+    LaneMask already = intersectLinesLanes(a1x, a1y, a2x, a2y, b1x, b1y, b2x, b2y);
+    LaneMask far = intersectLinesLanes(a1x, a1y, a2x, a2y, q1x, q1y, q2x, q2y);
+    LaneMask top = intersectLinesLanes(a1x, a1y, a2x, a2y, q1x, q1y, b1x, b1y);
+    LaneMask bottom = intersectLinesLanes(a1x, a1y, a2x, a2y, q2x, q2y, b2x, b2y);
+    LaneMask inside =
+        pointInParallelogramLanes(a1x, a1y, b1x, b1y, b2x, b2y, q1x, q1y, q2x, q2y)
+        & pointInParallelogramLanes(a2x, a2y, b1x, b1y, b2x, b2y, q1x, q1y, q2x, q2y);
+
+    // Resolve each lane with the same decision order as intersect().
+    const unsigned int lanes = numLines - k < INTERSECT_LANES ? numLines - k : INTERSECT_LANES;
+    for (unsigned int lane = 0; lane < lanes; lane++) {
+      if (already[lane]) {
+        results[k + lane] = ALREADY_INTERSECTED;
+        continue;
+      }
+      int num_line_intersections = (far[lane] != 0) + (top[lane] != 0) + (bottom[lane] != 0);
+      if (num_line_intersections == 2) {
+        results[k + lane] = L2_WITH_L1;
+      } else if (inside[lane]) {
+        results[k + lane] = L1_WITH_L2;
+      } else if (num_line_intersections == 0) {
+        results[k + lane] = NO_INTERSECTION;
+      } else {
+        const int angle = angleSign(LineStore_getDirection(lineStore, l1->id),
+                                    LineStore_getDirection(lineStore, l2Ids[k + lane]));
+        if (top[lane]) {
+          results[k + lane] = angle < 0 ? L2_WITH_L1 : L1_WITH_L2;
+        } else if (bottom[lane]) {
+          results[k + lane] = angle > 0 ? L2_WITH_L1 : L1_WITH_L2;
+        } else {
+          results[k + lane] = L1_WITH_L2;
+        }
+      }
+    }
+  }
+}
+
+static inline double minDouble(double a, double b) {
+  return a < b ? a : b;
+}
+
+static inline double maxDouble(double a, double b) {
+  return a > b ? a : b;
+}
+
+unsigned int rejectDisjointBounds(const Line *l1, const LineStore *lineStore,
+                                  const unsigned int *l2Ids, const unsigned int numLines,
+                                  double time, unsigned int *survivors) {
+  const double min1x = minDouble(l1->p1.x, l1->p2.x);
+  const double max1x = maxDouble(l1->p1.x, l1->p2.x);
+  const double min1y = minDouble(l1->p1.y, l1->p2.y);
+  const double max1y = maxDouble(l1->p1.y, l1->p2.y);
+
+  unsigned int numSurvivors = 0;
+  for (unsigned int k = 0; k < numLines; k++) {
+    const unsigned int id = l2Ids[k];
+    // Relative velocity and the parallelogram, as in intersect().  Every test
+    // intersect() makes looks at l1 against points or edges of the
+    // parallelogram, so when the boxes don't even touch they all fail.
+    const double vx = lineStore->vx[id] - l1->velocity.x;
+    const double vy = lineStore->vy[id] - l1->velocity.y;
+    const double b1x = lineStore->p1x[id];
+    const double b1y = lineStore->p1y[id];
+    const double b2x = lineStore->p2x[id];
+    const double b2y = lineStore->p2y[id];
+    const double q1x = b1x + vx * time;
+    const double q1y = b1y + vy * time;
+    const double q2x = b2x + vx * time;
+    const double q2y = b2y + vy * time;
+    const double min2x = minDouble(minDouble(b1x, b2x), minDouble(q1x, q2x));
+    const double max2x = maxDouble(maxDouble(b1x, b2x), maxDouble(q1x, q2x));
+    const double min2y = minDouble(minDouble(b1y, b2y), minDouble(q1y, q2y));
+    const double max2y = maxDouble(maxDouble(b1y, b2y), maxDouble(q1y, q2y));
+
+    // Written out without branches so the loop compacts in place.
+    survivors[numSurvivors] = id;
+    numSurvivors += (min2x <= max1x) & (min1x <= max2x) & (min2y <= max1y) & (min1y <= max2y);
+  }
+  return numSurvivors;
+}
+
 // Check if a point is in the parallelogram.
 bool pointInParallelogram(Vec point, Vec p1, Vec p2, Vec p3, Vec p4) {
   double d1 = direction(p1, p2, point);
@@ -147,7 +384,7 @@ Vec getIntersectionPoint(Vec p1, Vec p2, Vec p3, Vec p4) {
   u = ((p4.x - p3.x) * (p1.y - p3.y) - (p4.y - p3.y) * (p1.x - p3.x))
       / ((p4.y - p3.y) * (p2.x - p1.x) - (p4.x - p3.x) * (p2.y - p1.y));
 
-  return Vec_add(p1, Vec_multiply(Vec_subtract(p2, p1), u));
+  return Vec2_add(p1, Vec2_multiply(Vec2_subtract(p2, p1), u));
 }
 
 // Check the direction of two lines (pi, pj) and (pi, pk).
@@ -24,6 +24,7 @@
 #define INTERSECTIONDETECTION_H_
 
 #include "./line.h"
+#include "./line_store.h"
 #include "./vec.h"
 
 typedef enum {
@@ -37,6 +38,33 @@ typedef enum {
 // Precondition: compareLines(l1, l2) < 0 must be true.
 IntersectionType intersect(Line *l1, Line *l2, double time);
 
+// Number of candidate lines intersectBatch classifies at once: one AVX
+// register of doubles when AVX is enabled, one SSE2 register otherwise.
+#ifdef __AVX__
+#define INTERSECT_LANES 4
+#else
+#define INTERSECT_LANES 2
+#endif
+
+// Batched intersect(): classifies l1 against each line in l2Ids, writing
+// results[k] for l2Ids[k].  The line tests run INTERSECT_LANES candidates at a
+// time in vector lanes and give exactly the same result as calling intersect()
+// on each pair, except that the lines' directions come from the store's shapes
+// (see LineStore_computeShapes) rather than from their moved endpoints.
+// Precondition: l1->id < l2Ids[k] for every k.
+void intersectBatch(const Line *l1, const LineStore *lineStore,
+                    const unsigned int *l2Ids, const unsigned int numLines,
+                    double time, IntersectionType *results);
+
+// Cheap conservative reject ahead of intersectBatch(): drops each line in l2Ids
+// whose parallelogram under the relative velocity has a bounding box that misses
+// l1's, as intersect() can only give NO_INTERSECTION for those.  The rest are
+// written to survivors in the same order and their number is returned.
+// survivors may be l2Ids.
+unsigned int rejectDisjointBounds(const Line *l1, const LineStore *lineStore,
+                                  const unsigned int *l2Ids, const unsigned int numLines,
+                                  double time, unsigned int *survivors);
+
 // Check if a point is in the parallelogram.
 bool pointInParallelogram(Vec point, Vec p1, Vec p2, Vec p3, Vec p4);
 
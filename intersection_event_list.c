@@ -23,16 +23,25 @@
 #include "./intersection_event_list.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int IntersectionEventNode_compareData(IntersectionEventNode* node1,
-                                      IntersectionEventNode* node2) {
-  if (compareLines(node1->l1, node2->l1) < 0) {
+// Lists shorter than this are insertion sorted, a radix pass isn't worth it.
+#define INSERTION_SORT_CUTOFF 32
+
+// Radix digit width in bits.
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+int IntersectionEvent_compareData(const IntersectionEvent* event1,
+                                  const IntersectionEvent* event2) {
+  if (event1->l1Id < event2->l1Id) {
     return -1;
-  } else if (compareLines(node1->l1, node2->l1) == 0) {
-    if (compareLines(node1->l2, node2->l2) < 0) {
+  } else if (event1->l1Id == event2->l1Id) {
+    if (event1->l2Id < event2->l2Id) {
       return -1;
-    } else if (compareLines(node1->l2, node2->l2) == 0) {
+    } else if (event1->l2Id == event2->l2Id) {
       return 0;
     } else {
       return 1;
@@ -42,63 +51,135 @@ int IntersectionEventNode_compareData(IntersectionEventNode* node1,
   }
 }
 
-void IntersectionEventNode_swapData(IntersectionEventNode* node1,
-                                    IntersectionEventNode* node2) {
-  {
-    Line* temp = node1->l1;
-    node1->l1 = node2->l1;
-    node2->l1 = temp;
+IntersectionEventList IntersectionEventList_make() {
+  IntersectionEventList intersectionEventList;
+  intersectionEventList.events = NULL;
+  intersectionEventList.scratch = NULL;
+  intersectionEventList.size = 0;
+  intersectionEventList.capacity = 0;
+  return intersectionEventList;
+}
+
+// Makes room for at least capacity events.
+static void IntersectionEventList_reserve(
+    IntersectionEventList* intersectionEventList, unsigned int capacity) {
+  if (capacity <= intersectionEventList->capacity) {
+    return;
   }
-  {
-    Line* temp = node1->l2;
-    node1->l2 = node2->l2;
-    node2->l2 = temp;
+  unsigned int newCapacity = intersectionEventList->capacity == 0
+      ? 64 : intersectionEventList->capacity;
+  while (newCapacity < capacity) {
+    newCapacity *= 2;
   }
-  {
-    IntersectionType temp = node1->intersectionType;
-    node1->intersectionType = node2->intersectionType;
-    node2->intersectionType = temp;
+
+  IntersectionEvent* events = realloc(intersectionEventList->events,
+                                      newCapacity * sizeof(IntersectionEvent));
+  IntersectionEvent* scratch = realloc(intersectionEventList->scratch,
+                                       newCapacity * sizeof(IntersectionEvent));
+  if (events == NULL || scratch == NULL) {
+    fprintf(stderr, "Couldn't grow intersection event list\n");
+    exit(1);
   }
+  intersectionEventList->events = events;
+  intersectionEventList->scratch = scratch;
+  intersectionEventList->capacity = newCapacity;
 }
 
-IntersectionEventList IntersectionEventList_make() {
-  IntersectionEventList intersectionEventList;
-  intersectionEventList.head = NULL;
-  intersectionEventList.tail = NULL;
-  return intersectionEventList;
-}
+void IntersectionEventList_append(
+    IntersectionEventList* intersectionEventList, const unsigned int l1Id,
+    const unsigned int l2Id, IntersectionType intersectionType) {
+  assert(l1Id < l2Id);
 
-void IntersectionEventList_appendNode(
-    IntersectionEventList* intersectionEventList, Line* l1, Line* l2,
-    IntersectionType intersectionType) {
-  assert(compareLines(l1, l2) < 0);
+  if (intersectionEventList->size == intersectionEventList->capacity) {
+    IntersectionEventList_reserve(intersectionEventList,
+                                  intersectionEventList->size + 1);
+  }
 
-  IntersectionEventNode* newNode = malloc(sizeof(IntersectionEventNode));
-  if (newNode == NULL) {
+  IntersectionEvent* event =
+      &intersectionEventList->events[intersectionEventList->size++];
+  event->l1Id = l1Id;
+  event->l2Id = l2Id;
+  event->intersectionType = intersectionType;
+  event->key = ((uint64_t) l1Id << 32) | l2Id;
+}
+
+void IntersectionEventList_concat(IntersectionEventList* intersectionEventList,
+                                  const IntersectionEventList* other) {
+  if (other->size == 0) {
     return;
   }
+  IntersectionEventList_reserve(intersectionEventList,
+                                intersectionEventList->size + other->size);
+  memcpy(&intersectionEventList->events[intersectionEventList->size],
+         other->events, other->size * sizeof(IntersectionEvent));
+  intersectionEventList->size += other->size;
+}
 
-  newNode->l1 = l1;
-  newNode->l2 = l2;
-  newNode->intersectionType = intersectionType;
-  newNode->next = NULL;
-  if (intersectionEventList->head == NULL) {
-    intersectionEventList->head = newNode;
-  } else {
-    intersectionEventList->tail->next = newNode;
+static void IntersectionEventList_insertionSort(IntersectionEvent* events,
+                                                unsigned int size) {
+  for (unsigned int i = 1; i < size; i++) {
+    IntersectionEvent event = events[i];
+    unsigned int j = i;
+    while (j > 0 && events[j - 1].key > event.key) {
+      events[j] = events[j - 1];
+      j--;
+    }
+    events[j] = event;
   }
-  intersectionEventList->tail = newNode;
 }
 
-void IntersectionEventList_deleteNodes(
-    IntersectionEventList* intersectionEventList) {
-  IntersectionEventNode* curNode = intersectionEventList->head;
-  IntersectionEventNode* nextNode = NULL;
-  while (curNode != NULL) {
-    nextNode = curNode->next;
-    free(curNode);
-    curNode = nextNode;
+void IntersectionEventList_sort(IntersectionEventList* intersectionEventList) {
+  const unsigned int size = intersectionEventList->size;
+  if (size < INSERTION_SORT_CUTOFF) {
+    IntersectionEventList_insertionSort(intersectionEventList->events, size);
+    return;
   }
-  intersectionEventList->head = NULL;
-  intersectionEventList->tail = NULL;
+
+  // Only the digits that differ between keys need a pass.  Line IDs are
+  // small so this is usually 2 or 3 digits of each ID, not all 8 bytes.
+  uint64_t differing = 0;
+  const uint64_t first = intersectionEventList->events[0].key;
+  for (unsigned int i = 1; i < size; i++) {
+    differing |= intersectionEventList->events[i].key ^ first;
+  }
+
+  IntersectionEvent* src = intersectionEventList->events;
+  IntersectionEvent* dst = intersectionEventList->scratch;
+  for (unsigned int shift = 0; shift < 64; shift += RADIX_BITS) {
+    if (((differing >> shift) & (RADIX_BUCKETS - 1)) == 0) {
+      continue;
+    }
+
+    unsigned int offsets[RADIX_BUCKETS] = {0};
+    for (unsigned int i = 0; i < size; i++) {
+      offsets[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+    }
+    unsigned int total = 0;
+    for (unsigned int b = 0; b < RADIX_BUCKETS; b++) {
+      unsigned int count = offsets[b];
+      offsets[b] = total;
+      total += count;
+    }
+    for (unsigned int i = 0; i < size; i++) {
+      dst[offsets[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+    }
+
+    IntersectionEvent* temp = src;
+    src = dst;
+    dst = temp;
+  }
+
+  // The sorted events may have ended up in the scratch buffer.
+  intersectionEventList->events = src;
+  intersectionEventList->scratch = dst;
+}
+
+void IntersectionEventList_clear(IntersectionEventList* intersectionEventList) {
+  intersectionEventList->size = 0;
+}
+
+void IntersectionEventList_free(IntersectionEventList* intersectionEventList) {
+  free(intersectionEventList->events);
+  free(intersectionEventList->scratch);
+  *intersectionEventList = IntersectionEventList_make();
 }
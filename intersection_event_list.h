@@ -23,46 +23,59 @@
 #ifndef INTERSECTIONEVENTLIST_H_
 #define INTERSECTIONEVENTLIST_H_
 
+#include <stdint.h>
+
 #include "./line.h"
 #include "./intersection_detection.h"
 
-struct IntersectionEventNode {
-  // This IntersectionEventNode does not own these Line* lines.
-  Line* l1;
-  Line* l2;
+struct IntersectionEvent {
+  // IDs of the two lines.
+  unsigned int l1Id;
+  unsigned int l2Id;
   IntersectionType intersectionType;
-  struct IntersectionEventNode* next;
+  // (l1 ID, l2 ID) packed into one integer, the list is sorted on this.
+  uint64_t key;
 };
-typedef struct IntersectionEventNode IntersectionEventNode;
-
-// Compares the nodes by l1's line ID, then l1's line ID.
-// -1 <=> node1 ordered before node2
-//  0 <=> node1 ordered the same as node2
-//  1 <=> node1 ordered after node2
-int IntersectionEventNode_compareData(IntersectionEventNode* node1,
-                                      IntersectionEventNode* node2);
+typedef struct IntersectionEvent IntersectionEvent;
 
-// Swaps the node1's and node2's data (l1, l2, intersectionType).
-void IntersectionEventNode_swapData(IntersectionEventNode* node1,
-                                    IntersectionEventNode* node2);
+// Compares the events by l1's line ID, then l2's line ID.
+// -1 <=> event1 ordered before event2
+//  0 <=> event1 ordered the same as event2
+//  1 <=> event1 ordered after event2
+int IntersectionEvent_compareData(const IntersectionEvent* event1,
+                                  const IntersectionEvent* event2);
 
+// A growable array of events.  Clearing the list keeps its memory so the same
+// list can be refilled every frame without allocating.
 struct IntersectionEventList {
-  IntersectionEventNode* head;
-  IntersectionEventNode* tail;
+  IntersectionEvent* events;
+  // Second buffer of the same capacity used by the sort.
+  IntersectionEvent* scratch;
+  unsigned int size;
+  unsigned int capacity;
 };
 typedef struct IntersectionEventList IntersectionEventList;
 
 // Returns an empty list.
 IntersectionEventList IntersectionEventList_make();
 
-// Appends a new node to the list with the data (l1, l2, intersectionType).
-// Precondition: compareLines(l1, l2) < 0 must be true.
-void IntersectionEventList_appendNode(
-    IntersectionEventList* intersectionEventList, Line* l1, Line* l2,
-    IntersectionType intersectionType);
+// Appends an event with the data (l1Id, l2Id, intersectionType).
+// Precondition: l1Id < l2Id must be true.
+void IntersectionEventList_append(
+    IntersectionEventList* intersectionEventList, const unsigned int l1Id,
+    const unsigned int l2Id, IntersectionType intersectionType);
+
+// Appends all the events of other onto the end of the list.
+void IntersectionEventList_concat(IntersectionEventList* intersectionEventList,
+                                  const IntersectionEventList* other);
+
+// Sorts the events by (l1's line ID, l2's line ID) with an LSD radix sort.
+void IntersectionEventList_sort(IntersectionEventList* intersectionEventList);
+
+// Removes all the events but keeps the memory for reuse.
+void IntersectionEventList_clear(IntersectionEventList* intersectionEventList);
 
-// Deletes all the nodes in the list.
-void IntersectionEventList_deleteNodes(
-    IntersectionEventList* intersectionEventList);
+// Releases the memory held by the list.
+void IntersectionEventList_free(IntersectionEventList* intersectionEventList);
 
 #endif  // INTERSECTIONEVENTLIST_H_
@@ -67,7 +67,7 @@ typedef struct Line Line;
 // -1 <=> line1 ordered before line2
 //  0 <=> line1 ordered the same as line2
 //  1 <=> line1 ordered after line2
-static inline int compareLines(Line *line1, Line *line2) {
+static inline int compareLines(const Line *line1, const Line *line2) {
   if (line1->id < line2->id) {
     return -1;
   } else if (line1->id == line2->id) {
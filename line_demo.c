@@ -30,6 +30,7 @@
 
 #include "./graphic_stuff.h"
 #include "./line.h"
+#include "./scene_file.h"
 
 static char* LineDemo_input_file_path;
 
@@ -67,8 +68,30 @@ void LineDemo_delete(LineDemo* lineDemo) {
   free(lineDemo);
 }
 
-// Read in lines from line.in and add them into collision world for simulation.
-void LineDemo_createLines(LineDemo* lineDemo, bool quad_tree_flag) {
+// Map a binary scene file, the lines are used in place.
+static void LineDemo_mapLines(LineDemo* lineDemo, BroadPhase broad_phase) {
+  LineStore lineStore;
+  unsigned int numOfLines;
+  if (!SceneFile_map(LineDemo_input_file_path, &lineStore, &numOfLines)) {
+    exit(1);
+  }
+  lineDemo->collisionWorld = CollisionWorld_newWithLines(&lineStore, numOfLines,
+                                                         broad_phase);
+  if (lineDemo->collisionWorld == NULL) {
+    fprintf(stderr, "Couldn't create collision world\n");
+    exit(1);
+  }
+}
+
+// Read in lines from line.in (or a scene file, by extension) and add them into
+// collision world for simulation.
+void LineDemo_createLines(LineDemo* lineDemo, BroadPhase broad_phase) {
+  if (SceneFile_isSceneFile(LineDemo_input_file_path)) {
+    LineDemo_mapLines(lineDemo, broad_phase);
+    CollisionWorld_computeLineShapes(lineDemo->collisionWorld);
+    return;
+  }
+
   unsigned int lineId = 0;
   unsigned int numOfLines;
   window_dimension px1;
@@ -86,42 +109,43 @@ void LineDemo_createLines(LineDemo* lineDemo, bool quad_tree_flag) {
   }
 
   fscanf(fin, "%d\n", &numOfLines);
-  lineDemo->collisionWorld = CollisionWorld_new(numOfLines, quad_tree_flag);
+  lineDemo->collisionWorld = CollisionWorld_new(numOfLines, broad_phase);
 
   while (EOF
       != fscanf(fin, "(%lf, %lf), (%lf, %lf), %lf, %lf, %d\n", &px1, &py1, &px2,
                 &py2, &vx, &vy, &isGray)) {
-    Line *line = malloc(sizeof(Line));
+    Line line;
 
     // convert window coordinates to box coordinates
-    windowToBox(&line->p1.x, &line->p1.y, px1, py1);
-    windowToBox(&line->p2.x, &line->p2.y, px2, py2);
+    windowToBox(&line.p1.x, &line.p1.y, px1, py1);
+    windowToBox(&line.p2.x, &line.p2.y, px2, py2);
 
     // convert window velocity to box velocity
-    velocityWindowToBox(&line->velocity.x, &line->velocity.y, vx, vy);
+    velocityWindowToBox(&line.velocity.x, &line.velocity.y, vx, vy);
 
     // store color
-    line->color = (Color) isGray;
+    line.color = (Color) isGray;
 
     // store line ID
-    line->id = lineId;
+    line.id = lineId;
     lineId++;
 
-    // transfer ownership of line to collisionWorld
-    CollisionWorld_addLine(lineDemo->collisionWorld, line);
+    // copy line into collisionWorld
+    CollisionWorld_addLine(lineDemo->collisionWorld, &line);
   }
   fclose(fin);
+  CollisionWorld_computeLineShapes(lineDemo->collisionWorld);
 }
 
 void LineDemo_setNumFrames(LineDemo* lineDemo, const unsigned int numFrames) {
   lineDemo->numFrames = numFrames;
 }
 
-void LineDemo_initLine(LineDemo* lineDemo, bool quad_tree_flag) {
-  LineDemo_createLines(lineDemo, quad_tree_flag);
+void LineDemo_initLine(LineDemo* lineDemo, BroadPhase broad_phase) {
+  LineDemo_createLines(lineDemo, broad_phase);
 }
 
-Line* LineDemo_getLine(LineDemo* lineDemo, const unsigned int index) {
+Line LineDemo_getLine(LineDemo* lineDemo, const unsigned int index) {
   return CollisionWorld_getLine(lineDemo->collisionWorld, index);
 }
 
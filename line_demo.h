@@ -45,16 +45,16 @@ LineDemo* LineDemo_new();
 void LineDemo_delete(LineDemo* lineDemo);
 
 // Add lines for line simulation at beginning.
-void LineDemo_createLines(LineDemo* lineDemo, bool quad_tree_flag);
+void LineDemo_createLines(LineDemo* lineDemo, BroadPhase broad_phase);
 
 // Set number of frames to compute.
 void LineDemo_setNumFrames(LineDemo* lineDemo, const unsigned int numFrames);
 
 // Initialize line simulation.
-void LineDemo_initLine(LineDemo* lineDemo, bool quad_tree_flag);
+void LineDemo_initLine(LineDemo* lineDemo, BroadPhase broad_phase);
 
-// Get ith line.
-Line* LineDemo_getLine(LineDemo* lineDemo, const unsigned int index);
+// Get a copy of the ith line.
+Line LineDemo_getLine(LineDemo* lineDemo, const unsigned int index);
 
 // Get num of lines.
 unsigned int LineDemo_getNumOfLines(LineDemo* lineDemo);
@@ -0,0 +1,96 @@
+#include "./line_store.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+bool LineStore_init(LineStore* store, const unsigned int capacity) {
+  store->mapping = NULL;
+  store->mappingBytes = 0;
+  store->p1x = malloc(capacity * sizeof(box_dimension));
+  store->p1y = malloc(capacity * sizeof(box_dimension));
+  store->p2x = malloc(capacity * sizeof(box_dimension));
+  store->p2y = malloc(capacity * sizeof(box_dimension));
+  store->vx = malloc(capacity * sizeof(box_dimension));
+  store->vy = malloc(capacity * sizeof(box_dimension));
+  store->color = malloc(capacity * sizeof(Color));
+  store->capacity = capacity;
+
+  if (!LineStore_initShapes(store, capacity)
+      || store->p1x == NULL || store->p1y == NULL || store->p2x == NULL
+      || store->p2y == NULL || store->vx == NULL || store->vy == NULL
+      || store->color == NULL) {
+    LineStore_free(store);
+    return false;
+  }
+  return true;
+}
+
+bool LineStore_initShapes(LineStore* store, const unsigned int capacity) {
+  store->dirx = malloc(capacity * sizeof(box_dimension));
+  store->diry = malloc(capacity * sizeof(box_dimension));
+  store->length = malloc(capacity * sizeof(box_dimension));
+  store->facex = malloc(capacity * sizeof(box_dimension));
+  store->facey = malloc(capacity * sizeof(box_dimension));
+  store->normalx = malloc(capacity * sizeof(box_dimension));
+  store->normaly = malloc(capacity * sizeof(box_dimension));
+
+  return store->dirx != NULL && store->diry != NULL && store->length != NULL
+      && store->facex != NULL && store->facey != NULL
+      && store->normalx != NULL && store->normaly != NULL;
+}
+
+void LineStore_free(LineStore* store) {
+  if (store->mapping != NULL) {
+    munmap(store->mapping, store->mappingBytes);
+  } else {
+    free(store->p1x);
+    free(store->p1y);
+    free(store->p2x);
+    free(store->p2y);
+    free(store->vx);
+    free(store->vy);
+    free(store->color);
+  }
+  free(store->dirx);
+  free(store->diry);
+  free(store->length);
+  free(store->facex);
+  free(store->facey);
+  free(store->normalx);
+  free(store->normaly);
+  store->mapping = NULL;
+  store->mappingBytes = 0;
+  store->p1x = NULL;
+  store->p1y = NULL;
+  store->p2x = NULL;
+  store->p2y = NULL;
+  store->vx = NULL;
+  store->vy = NULL;
+  store->color = NULL;
+  store->dirx = NULL;
+  store->diry = NULL;
+  store->length = NULL;
+  store->facex = NULL;
+  store->facey = NULL;
+  store->normalx = NULL;
+  store->normaly = NULL;
+  store->capacity = 0;
+}
+
+void LineStore_computeShapes(LineStore* store, const unsigned int numLines) {
+  assert(numLines <= store->capacity);
+
+  for (unsigned int i = 0; i < numLines; i++) {
+    const Line line = LineStore_getLine(store, i);
+    const Vec direction = Vec2_subtract(line.p1, line.p2);
+    const Vec face = Vec2_normalize(direction);
+    const Vec normal = Vec2_orthogonal(face);
+    store->dirx[i] = direction.x;
+    store->diry[i] = direction.y;
+    store->length[i] = Vec2_length(direction);
+    store->facex[i] = face.x;
+    store->facey[i] = face.y;
+    store->normalx[i] = normal.x;
+    store->normaly[i] = normal.y;
+  }
+}
@@ -0,0 +1,139 @@
+// line_store.h -- line data stored as parallel arrays indexed by line ID
+#ifndef LINESTORE_H_
+#define LINESTORE_H_
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+
+#include "./line.h"
+
+// How far LineStore_sweptBox pads each side of a swept box, in box coordinates.
+// intersect() moves l2 by the relative velocity, and its rounding can report a
+// contact that the two lines' own swept boxes miss by an ulp.
+#define SWEPT_BOX_SLACK 1e-9
+
+// Structure-of-arrays storage for every line in the world.  Entry i of each
+// array belongs to the line with ID i, so the ID is the index and is not stored.
+// Sweeps over all lines (moving them, bouncing them off the walls) only touch
+// the arrays they need and walk memory linearly.
+struct LineStore {
+  box_dimension* p1x;
+  box_dimension* p1y;
+  box_dimension* p2x;
+  box_dimension* p2y;
+  box_dimension* vx;
+  box_dimension* vy;
+  Color* color;
+
+  // Lines only ever translate, so their shape is worked out once at load by
+  // LineStore_computeShapes: p1 - p2, its length (the line's mass), the unit
+  // face vector along it and the normal to that.  Always malloced, also for
+  // a mapped scene file.
+  box_dimension* dirx;
+  box_dimension* diry;
+  box_dimension* length;
+  box_dimension* facex;
+  box_dimension* facey;
+  box_dimension* normalx;
+  box_dimension* normaly;
+
+  unsigned int capacity;
+
+  // Set when the arrays point into a mapped scene file (see scene_file.h)
+  // instead of being malloced.  The mapping is released by LineStore_free.
+  void* mapping;
+  size_t mappingBytes;
+};
+typedef struct LineStore LineStore;
+
+// Allocates room for capacity lines.  Returns false if out of memory.
+bool LineStore_init(LineStore* store, const unsigned int capacity);
+// Allocates the shape arrays only, for stores whose line arrays are mapped.
+bool LineStore_initShapes(LineStore* store, const unsigned int capacity);
+void LineStore_free(LineStore* store);
+
+// Works out the shape of the first numLines lines from their endpoints.
+void LineStore_computeShapes(LineStore* store, const unsigned int numLines);
+
+// Writes the line into the slot for its ID.
+static inline void LineStore_setLine(LineStore* store, const Line* line) {
+  assert(line->id < store->capacity);
+
+  const unsigned int id = line->id;
+  store->p1x[id] = line->p1.x;
+  store->p1y[id] = line->p1.y;
+  store->p2x[id] = line->p2.x;
+  store->p2y[id] = line->p2.y;
+  store->vx[id] = line->velocity.x;
+  store->vy[id] = line->velocity.y;
+  store->color[id] = line->color;
+}
+
+// Returns a copy of the line with the given ID.
+static inline Line LineStore_getLine(const LineStore* store,
+                                     const unsigned int id) {
+  assert(id < store->capacity);
+
+  Line line;
+  line.p1.x = store->p1x[id];
+  line.p1.y = store->p1y[id];
+  line.p2.x = store->p2x[id];
+  line.p2.y = store->p2y[id];
+  line.velocity.x = store->vx[id];
+  line.velocity.y = store->vy[id];
+  line.color = store->color[id];
+  line.id = id;
+  return line;
+}
+
+static inline void LineStore_setVelocity(LineStore* store,
+                                         const unsigned int id, Vec velocity) {
+  assert(id < store->capacity);
+
+  store->vx[id] = velocity.x;
+  store->vy[id] = velocity.y;
+}
+
+static inline Vec LineStore_getDirection(const LineStore* store,
+                                         const unsigned int id) {
+  assert(id < store->capacity);
+
+  return Vec2_make(store->dirx[id], store->diry[id]);
+}
+
+static inline Vec LineStore_getFace(const LineStore* store,
+                                    const unsigned int id) {
+  assert(id < store->capacity);
+
+  return Vec2_make(store->facex[id], store->facey[id]);
+}
+
+static inline Vec LineStore_getNormal(const LineStore* store,
+                                      const unsigned int id) {
+  assert(id < store->capacity);
+
+  return Vec2_make(store->normalx[id], store->normaly[id]);
+}
+
+// Bounding box of line i and where it will be after time t, padded by
+// SWEPT_BOX_SLACK.  Any two lines intersect() can report hitting each other in
+// the next time step have overlapping boxes, so broad phases can prune with it.
+static inline void LineStore_sweptBox(const LineStore* store, const unsigned int id,
+                                      const double t, double* min_x, double* max_x,
+                                      double* min_y, double* max_y) {
+  assert(id < store->capacity);
+
+  const double move_x = store->vx[id] * t;
+  const double move_y = store->vy[id] * t;
+  const double lo_x = fmin(store->p1x[id], store->p2x[id]);
+  const double hi_x = fmax(store->p1x[id], store->p2x[id]);
+  const double lo_y = fmin(store->p1y[id], store->p2y[id]);
+  const double hi_y = fmax(store->p1y[id], store->p2y[id]);
+  *min_x = fmin(lo_x, lo_x + move_x) - SWEPT_BOX_SLACK;
+  *max_x = fmax(hi_x, hi_x + move_x) + SWEPT_BOX_SLACK;
+  *min_y = fmin(lo_y, lo_y + move_y) - SWEPT_BOX_SLACK;
+  *max_y = fmax(hi_y, hi_y + move_y) + SWEPT_BOX_SLACK;
+}
+
+#endif  // LINESTORE_H_
@@ -0,0 +1,135 @@
+// phase_timing.c -- see phase_timing.h.  Empty unless built with -DPHASE_TIMING.
+#ifdef PHASE_TIMING
+
+#include "./phase_timing.h"
+
+#include <float.h>
+#include <string.h>
+
+// Histogram buckets are powers of two: times in microseconds, counters as is.
+// Bucket 0 holds everything below 1, bucket b holds [2^(b-1), 2^b).
+#define NUM_BUCKETS 32
+#define HISTOGRAM_BAR_WIDTH 40
+
+typedef struct Histogram {
+  unsigned long buckets[NUM_BUCKETS];
+  double total;
+  double min;
+  double max;
+} Histogram;
+
+static const char* phaseNames[NUM_PHASES] = {
+  "broad phase build",
+  "quad tree pair walk",
+  "narrow phase",
+  "event sort",
+  "collision solver",
+  "advance lines",
+  "frame",
+};
+
+static const char* counterNames[NUM_COUNTERS] = {
+  "candidates tested",
+  "rejected by bounds",
+  "events",
+  "tree nodes",
+  "tree elements",
+  "solver batches",
+  "pair cache refreshes",
+};
+
+// This frame so far
+static double frameTimes[NUM_PHASES];
+static unsigned long frameCounts[NUM_COUNTERS];
+
+static Histogram phaseHistograms[NUM_PHASES];
+static Histogram counterHistograms[NUM_COUNTERS];
+static unsigned long numFrames = 0;
+
+static unsigned int bucketOf(double value) {
+  unsigned int bucket = 0;
+  while (value >= 1.0 && bucket < NUM_BUCKETS - 1) {
+    value /= 2;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void histogramAdd(Histogram* histogram, const double value) {
+  if (numFrames == 0) {
+    histogram->min = DBL_MAX;
+    histogram->max = 0;
+  }
+  histogram->buckets[bucketOf(value)]++;
+  histogram->total += value;
+  if (value < histogram->min) {
+    histogram->min = value;
+  }
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+}
+
+static void histogramPrint(FILE* out, const char* name, const char* unit,
+                           const Histogram* histogram) {
+  fprintf(out, "%s: total %.1f%s, per frame mean %.2f min %.2f max %.2f\n",
+          name, histogram->total, unit, histogram->total / numFrames,
+          histogram->min, histogram->max);
+
+  unsigned long most = 0;
+  for (unsigned int b = 0; b < NUM_BUCKETS; b++) {
+    if (histogram->buckets[b] > most) {
+      most = histogram->buckets[b];
+    }
+  }
+  for (unsigned int b = 0; b < NUM_BUCKETS; b++) {
+    if (histogram->buckets[b] == 0) {
+      continue;
+    }
+    const double low = b == 0 ? 0 : (double) (1UL << (b - 1));
+    const double high = (double) (1UL << b);
+    const unsigned int width = (unsigned int)
+        ((histogram->buckets[b] * HISTOGRAM_BAR_WIDTH + most - 1) / most);
+    char bar[HISTOGRAM_BAR_WIDTH + 1];
+    memset(bar, '#', width);
+    bar[width] = '\0';
+    fprintf(out, "  [%10.0f, %10.0f)%s %8lu %s\n", low, high, unit,
+            histogram->buckets[b], bar);
+  }
+}
+
+void PhaseTiming_addTime(const Phase phase, const double seconds) {
+  frameTimes[phase] += seconds;
+}
+
+void PhaseTiming_addCount(const Counter counter, const unsigned long count) {
+  __atomic_fetch_add(&frameCounts[counter], count, __ATOMIC_RELAXED);
+}
+
+void PhaseTiming_endFrame(void) {
+  for (unsigned int p = 0; p < NUM_PHASES; p++) {
+    histogramAdd(&phaseHistograms[p], frameTimes[p] * 1e6);
+    frameTimes[p] = 0;
+  }
+  for (unsigned int c = 0; c < NUM_COUNTERS; c++) {
+    histogramAdd(&counterHistograms[c], (double) frameCounts[c]);
+    frameCounts[c] = 0;
+  }
+  numFrames++;
+}
+
+void PhaseTiming_print(FILE* out) {
+  if (numFrames == 0) {
+    return;
+  }
+  fprintf(out, "---- PHASE TIMING (%lu frames) ----\n", numFrames);
+  for (unsigned int p = 0; p < NUM_PHASES; p++) {
+    histogramPrint(out, phaseNames[p], "us", &phaseHistograms[p]);
+  }
+  for (unsigned int c = 0; c < NUM_COUNTERS; c++) {
+    histogramPrint(out, counterNames[c], "", &counterHistograms[c]);
+  }
+  fprintf(out, "---- END PHASE TIMING ----\n\n");
+}
+
+#endif  // PHASE_TIMING
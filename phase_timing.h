@@ -0,0 +1,65 @@
+// phase_timing.h -- per-phase timings and counters for each simulation frame
+#ifndef PHASETIMING_H_
+#define PHASETIMING_H_
+
+#include <stdio.h>
+
+// Build with -DPHASE_TIMING (make PHASE_TIMING=1) to turn this on.  Otherwise
+// every macro below expands to nothing and the hot path is untouched.
+//
+// Each phase is timed with fasttime.h and the times are summed over the frame.
+// PHASE_TIMING_END_FRAME() files the frame's totals into log2 histograms, which
+// PhaseTiming_print() reports at exit.
+
+typedef enum {
+  PHASE_BROAD_PHASE_BUILD,  // quad tree clear/fill or update, grid build, sort and sweep update
+  PHASE_PAIR_WALK,          // (linear) quad tree pair walk and grouping pairs by line
+  PHASE_NARROW_PHASE,       // broad phase queries and intersect tests
+  PHASE_EVENT_SORT,
+  PHASE_COLLISION_SOLVER,
+  PHASE_ADVANCE,            // moving the lines and wall collisions, one fused pass
+  PHASE_FRAME,              // all of CollisionWorld_updateLines
+  NUM_PHASES
+} Phase;
+
+typedef enum {
+  COUNTER_CANDIDATES,     // line pairs handed to the narrow phase
+  COUNTER_BOUNDS_REJECTS, // ...of which the swept bounds test dropped before intersect
+  COUNTER_EVENTS,         // intersections found
+  COUNTER_TREE_NODES,     // quad tree (or linear quad tree) nodes after the build
+  COUNTER_TREE_ELEMENTS,  // quad tree element slots in use after the build
+  COUNTER_SOLVER_BATCHES, // conflict free batches the parallel solver ran
+  COUNTER_PAIR_CACHE_REFRESHES,  // 1 when the pair cache was rebuilt this frame
+  NUM_COUNTERS
+} Counter;
+
+#ifdef PHASE_TIMING
+
+#include "./fasttime.h"
+
+void PhaseTiming_addTime(const Phase phase, const double seconds);
+// Safe to call from parallel code
+void PhaseTiming_addCount(const Counter counter, const unsigned long count);
+void PhaseTiming_endFrame(void);
+void PhaseTiming_print(FILE* out);
+
+#define PHASE_TIMING_BEGIN(phase) \
+  const fasttime_t phaseStart_##phase = gettime()
+#define PHASE_TIMING_END(phase) \
+  PhaseTiming_addTime(phase, tdiff(phaseStart_##phase, gettime()))
+#define PHASE_TIMING_COUNT(counter, count) \
+  PhaseTiming_addCount(counter, count)
+#define PHASE_TIMING_END_FRAME() PhaseTiming_endFrame()
+#define PHASE_TIMING_PRINT(out) PhaseTiming_print(out)
+
+#else
+
+#define PHASE_TIMING_BEGIN(phase)
+#define PHASE_TIMING_END(phase)
+#define PHASE_TIMING_COUNT(counter, count)
+#define PHASE_TIMING_END_FRAME()
+#define PHASE_TIMING_PRINT(out)
+
+#endif  // PHASE_TIMING
+
+#endif  // PHASETIMING_H_
@@ -1 +1 @@
-sudo clang -std=c99 -Wall main.c quad_tree.c small_list.c free_list.c ../intersection_detection.c ../vec.c -lm -lrt
+sudo clang -std=c99 -Wall main.c quad_tree.c small_list.c free_list.c frame_arena.c ../intersection_detection.c ../vec.c -lm -lrt
@@ -0,0 +1,91 @@
+#include "logging.h"
+#include "frame_arena.h"
+
+static inline size_t FrameArena_AlignUp(const size_t bytes) {
+  return (bytes + (FRAME_ARENA_ALIGNMENT - 1)) & ~(size_t)(FRAME_ARENA_ALIGNMENT - 1);
+}
+
+void FrameArena_Init(FrameArena* arena, const size_t capacity) {
+  assert(arena);
+
+  arena->capacity = FrameArena_AlignUp(capacity);
+  arena->base     = arena->capacity ? malloc(arena->capacity) : NULL;
+  if(arena->capacity && !arena->base) {
+    LOG("%s(): Couldn't malloc arena\n", __func__);
+    arena->capacity = 0;
+  }
+  arena->used = 0;
+
+  arena->overflow          = NULL;
+  arena->num_overflow      = 0;
+  arena->overflow_capacity = 0;
+  arena->overflow_bytes    = 0;
+}
+
+void* FrameArena_Alloc(FrameArena* arena, const size_t bytes) {
+  assert(arena);
+
+  const size_t aligned_bytes = FrameArena_AlignUp(bytes);
+  if(aligned_bytes <= arena->capacity - arena->used) {
+    void* result = arena->base + arena->used;
+    arena->used += aligned_bytes;
+    return result;
+  }
+
+  // doesn't fit this frame, hand out heap memory until the next reset
+  if(arena->num_overflow == arena->overflow_capacity) {
+    const unsigned int new_cap = arena->overflow_capacity ? arena->overflow_capacity * 2 : 16;
+    void** new_overflow = realloc(arena->overflow, new_cap * sizeof(void*));
+    if(!new_overflow) {
+      LOG("%s(): Couldn't realloc overflow list\n", __func__);
+      return NULL;
+    }
+    arena->overflow          = new_overflow;
+    arena->overflow_capacity = new_cap;
+  }
+  void* result = malloc(aligned_bytes);
+  if(!result) {
+    LOG("%s(): Couldn't malloc overflow\n", __func__);
+    return NULL;
+  }
+  arena->overflow[arena->num_overflow++] = result;
+  arena->overflow_bytes += aligned_bytes;
+  return result;
+}
+
+void FrameArena_Reset(FrameArena* arena) {
+  assert(arena);
+
+  if(arena->num_overflow > 0) {
+    for(unsigned int i = 0; i < arena->num_overflow; ++i) {
+      free(arena->overflow[i]);
+    }
+
+    // grow so a frame like this one fits without overflowing
+    const size_t new_cap = FrameArena_AlignUp((arena->capacity + arena->overflow_bytes) * 2);
+    char* new_base = malloc(new_cap);
+    if(new_base) {
+      free(arena->base);
+      arena->base     = new_base;
+      arena->capacity = new_cap;
+    }
+    else {
+      LOG("%s(): Couldn't grow arena\n", __func__);
+    }
+    arena->num_overflow   = 0;
+    arena->overflow_bytes = 0;
+  }
+
+  arena->used = 0;
+}
+
+void FrameArena_Free(FrameArena* arena) {
+  assert(arena);
+
+  for(unsigned int i = 0; i < arena->num_overflow; ++i) {
+    free(arena->overflow[i]);
+  }
+  free(arena->overflow);
+  free(arena->base);
+  FrameArena_Init(arena, 0);
+}
@@ -0,0 +1,34 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdbool.h>
+
+#define FRAME_ARENA_ALIGNMENT 16
+
+// Bump allocator for memory that only lives for one frame.
+// Allocations are never freed one at a time, everything is given back by FrameArena_Reset.
+//
+// If a frame needs more than capacity the extra allocations fall back to malloc
+// and are kept in .overflow. The next reset frees them and grows the block so
+// the same frame fits. After a few frames there are no more calls to malloc.
+typedef struct FrameArena {
+  char*  base;
+  size_t capacity;
+  size_t used;
+
+  void**       overflow;
+  unsigned int num_overflow;
+  unsigned int overflow_capacity;
+  size_t       overflow_bytes;
+} FrameArena;
+
+void  FrameArena_Init(FrameArena* arena, const size_t capacity);
+void* FrameArena_Alloc(FrameArena* arena, const size_t bytes);
+void  FrameArena_Reset(FrameArena* arena);
+void  FrameArena_Free(FrameArena* arena);
+
+#endif
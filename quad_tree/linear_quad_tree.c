@@ -0,0 +1,280 @@
+#include <math.h>
+#include <stdbool.h>
+#include "logging.h"
+#include "linear_quad_tree.h"
+#include "../line.h"
+
+#ifdef __cilk
+#include <cilk/cilk.h>
+#else
+#define cilk_for for
+#endif
+
+#define LEVEL_BITS  5
+#define RADIX_BITS  8
+#define RADIX_SIZE  (1 << RADIX_BITS)
+// Morton code is 2 * LINEAR_QUAD_TREE_BITS wide with the level under it
+#define NUM_DIGITS  ((2 * LINEAR_QUAD_TREE_BITS + LEVEL_BITS + RADIX_BITS - 1) / RADIX_BITS)
+
+// PRIVATE DECLARATIONS
+static void LinearQuadTree_Reserve(LinearQuadTree* lqt, const unsigned int num_lines);
+static void LinearQuadTree_SortEntries(LinearQuadTree* lqt);
+static void LinearQuadTree_BuildNodes(LinearQuadTree* lqt);
+
+
+// INLINES
+static inline uint32_t LinearQuadTree_Quantize(const double coord, const double box_min,
+                                               const double box_size) {
+  const uint32_t max_cell = (1u << LINEAR_QUAD_TREE_BITS) - 1;
+  const double cell = (coord - box_min) / box_size * (double)(1u << LINEAR_QUAD_TREE_BITS);
+  if(!(cell >= 0.0)) {
+    return 0;
+  }
+  if(cell >= (double)max_cell) {
+    return max_cell;
+  }
+  return (uint32_t)cell;
+}
+
+// spreads the low 16 bits of v out to the even bits
+static inline uint64_t LinearQuadTree_SpreadBits(const uint32_t v) {
+  uint64_t x = v & 0xFFFF;
+  x = (x | (x << 8)) & 0x00FF00FF;
+  x = (x | (x << 4)) & 0x0F0F0F0F;
+  x = (x | (x << 2)) & 0x33333333;
+  x = (x | (x << 1)) & 0x55555555;
+  return x;
+}
+
+static inline uint64_t LinearQuadTree_Morton(const uint32_t x, const uint32_t y) {
+  return LinearQuadTree_SpreadBits(x) | (LinearQuadTree_SpreadBits(y) << 1);
+}
+
+// Deepest level whose cell holds the whole box, the levels where the min and
+// max corners still agree on every bit
+static inline int LinearQuadTree_GetLevel(const LinearQuadBox* box) {
+  const uint32_t diff = (box->min_x ^ box->max_x) | (box->min_y ^ box->max_y);
+  if(diff == 0) {
+    return LINEAR_QUAD_TREE_BITS;
+  }
+  return LINEAR_QUAD_TREE_BITS - (32 - __builtin_clz(diff));
+}
+
+static inline bool LinearQuadTree_BoxesOverlap(const LinearQuadBox* a, const LinearQuadBox* b) {
+  return a->min_x <= b->max_x && b->min_x <= a->max_x &&
+         a->min_y <= b->max_y && b->min_y <= a->max_y;
+}
+
+static inline bool LinearQuadTree_CellOverlapsBox(const LinearQuadNode* node, const LinearQuadBox* box) {
+  const uint32_t last = (1u << (LINEAR_QUAD_TREE_BITS - node->level)) - 1;
+  return node->cell_x <= box->max_x && box->min_x <= node->cell_x + last &&
+         node->cell_y <= box->max_y && box->min_y <= node->cell_y + last;
+}
+
+static inline bool LinearQuadTree_IsAncestor(const LinearQuadNode* ancestor, const LinearQuadNode* node) {
+  const int shift = LINEAR_QUAD_TREE_BITS - ancestor->level;
+  return ancestor->level < node->level &&
+         (ancestor->cell_x >> shift) == (node->cell_x >> shift) &&
+         (ancestor->cell_y >> shift) == (node->cell_y >> shift);
+}
+
+
+// PUBLIC
+void LinearQuadTree_Init(LinearQuadTree* lqt, const LineStore* lines) {
+  assert(lqt);
+  assert(lines);
+
+  lqt->lines     = lines;
+  lqt->entries   = NULL;
+  lqt->scratch   = NULL;
+  lqt->boxes     = NULL;
+  lqt->num_lines = 0;
+  lqt->nodes     = NULL;
+  lqt->num_nodes = 0;
+}
+
+void LinearQuadTree_Free(LinearQuadTree* lqt) {
+  assert(lqt);
+
+  free(lqt->entries);
+  free(lqt->scratch);
+  free(lqt->boxes);
+  free(lqt->nodes);
+  LinearQuadTree_Init(lqt, lqt->lines);
+}
+
+void LinearQuadTree_Build(LinearQuadTree* lqt, const unsigned int num_lines, const double time_step) {
+  assert(lqt);
+
+  LinearQuadTree_Reserve(lqt, num_lines);
+
+  const LineStore* lines = lqt->lines;
+  const double box_width  = (double)BOX_XMAX - BOX_XMIN;
+  const double box_height = (double)BOX_YMAX - BOX_YMIN;
+  cilk_for(unsigned int i = 0; i < num_lines; ++i) {
+    const double dx = lines->vx[i] * time_step;
+    const double dy = lines->vy[i] * time_step;
+    double min_x = fmin(lines->p1x[i], lines->p2x[i]);
+    double max_x = fmax(lines->p1x[i], lines->p2x[i]);
+    double min_y = fmin(lines->p1y[i], lines->p2y[i]);
+    double max_y = fmax(lines->p1y[i], lines->p2y[i]);
+    min_x = fmin(min_x, min_x + dx);
+    max_x = fmax(max_x, max_x + dx);
+    min_y = fmin(min_y, min_y + dy);
+    max_y = fmax(max_y, max_y + dy);
+
+    // flooring is monotone so boxes that overlap still overlap once quantized
+    LinearQuadBox box;
+    box.min_x = LinearQuadTree_Quantize(min_x, BOX_XMIN, box_width);
+    box.max_x = LinearQuadTree_Quantize(max_x, BOX_XMIN, box_width);
+    box.min_y = LinearQuadTree_Quantize(min_y, BOX_YMIN, box_height);
+    box.max_y = LinearQuadTree_Quantize(max_y, BOX_YMIN, box_height);
+    lqt->boxes[i] = box;
+
+    const int level = LinearQuadTree_GetLevel(&box);
+    const int shift = LINEAR_QUAD_TREE_BITS - level;
+    const uint32_t cell_x = (box.min_x >> shift) << shift;
+    const uint32_t cell_y = (box.min_y >> shift) << shift;
+    lqt->entries[i].key     = (LinearQuadTree_Morton(cell_x, cell_y) << LEVEL_BITS) | (uint64_t)level;
+    lqt->entries[i].line_id = i;
+  }
+
+  LinearQuadTree_SortEntries(lqt);
+  LinearQuadTree_BuildNodes(lqt);
+}
+
+void LinearQuadTree_ForEachCandidatePair(const LinearQuadTree* lqt, QuadTreePairCallback callback,
+                                         void* data) {
+  assert(lqt);
+  assert(callback);
+
+  const LinearQuadEntry* entries = lqt->entries;
+  for(unsigned int n = 0; n < lqt->num_nodes; ++n) {
+    const LinearQuadNode* node = &lqt->nodes[n];
+    const unsigned int end = node->first + node->count;
+    for(unsigned int p = node->first; p < end; ++p) {
+      const unsigned int line_a = entries[p].line_id;
+      const LinearQuadBox* box_a = &lqt->boxes[line_a];
+
+      // lines after this one in the same cell
+      for(unsigned int q = p + 1; q < end; ++q) {
+        const unsigned int line_b = entries[q].line_id;
+        if(LinearQuadTree_BoxesOverlap(box_a, &lqt->boxes[line_b])) {
+          callback(data, line_a < line_b ? line_a : line_b, line_a < line_b ? line_b : line_a);
+        }
+      }
+
+      // lines in descendant cells, skipping subtrees the box misses
+      unsigned int m = n + 1;
+      while(m < node->subtree_end) {
+        const LinearQuadNode* other = &lqt->nodes[m];
+        if(!LinearQuadTree_CellOverlapsBox(other, box_a)) {
+          m = other->subtree_end;
+          continue;
+        }
+        for(unsigned int q = other->first; q < other->first + other->count; ++q) {
+          const unsigned int line_b = entries[q].line_id;
+          if(LinearQuadTree_BoxesOverlap(box_a, &lqt->boxes[line_b])) {
+            callback(data, line_a < line_b ? line_a : line_b, line_a < line_b ? line_b : line_a);
+          }
+        }
+        ++m;
+      }
+    }
+  }
+}
+
+
+// PRIVATE
+static void LinearQuadTree_Reserve(LinearQuadTree* lqt, const unsigned int num_lines) {
+  if(lqt->num_lines == num_lines && lqt->entries != NULL) {
+    return;
+  }
+
+  free(lqt->entries);
+  free(lqt->scratch);
+  free(lqt->boxes);
+  free(lqt->nodes);
+  lqt->entries = malloc(num_lines * sizeof(LinearQuadEntry));
+  lqt->scratch = malloc(num_lines * sizeof(LinearQuadEntry));
+  lqt->boxes   = malloc(num_lines * sizeof(LinearQuadBox));
+  lqt->nodes   = malloc(num_lines * sizeof(LinearQuadNode));
+  if(!lqt->entries || !lqt->scratch || !lqt->boxes || !lqt->nodes) {
+    LOG("%s(): Couldn't malloc for linear quad tree\n", __func__);
+    exit(1);
+  }
+  lqt->num_lines = num_lines;
+}
+
+// LSD radix sort on the keys, 8 bits at a time. Stable, so lines in the same
+// cell stay in id order. Digits that are the same for every key are skipped.
+static void LinearQuadTree_SortEntries(LinearQuadTree* lqt) {
+  unsigned int counts[NUM_DIGITS][RADIX_SIZE];
+  memset(counts, 0, sizeof(counts));
+  for(unsigned int i = 0; i < lqt->num_lines; ++i) {
+    const uint64_t key = lqt->entries[i].key;
+    for(int d = 0; d < NUM_DIGITS; ++d) {
+      counts[d][(key >> (d * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+    }
+  }
+
+  for(int d = 0; d < NUM_DIGITS; ++d) {
+    const uint64_t first_key = lqt->num_lines ? lqt->entries[0].key : 0;
+    if(counts[d][(first_key >> (d * RADIX_BITS)) & (RADIX_SIZE - 1)] == lqt->num_lines) {
+      continue;
+    }
+
+    unsigned int offset = 0;
+    for(int b = 0; b < RADIX_SIZE; ++b) {
+      const unsigned int count = counts[d][b];
+      counts[d][b] = offset;
+      offset += count;
+    }
+    for(unsigned int i = 0; i < lqt->num_lines; ++i) {
+      const LinearQuadEntry entry = lqt->entries[i];
+      lqt->scratch[counts[d][(entry.key >> (d * RADIX_BITS)) & (RADIX_SIZE - 1)]++] = entry;
+    }
+
+    LinearQuadEntry* temp = lqt->entries;
+    lqt->entries = lqt->scratch;
+    lqt->scratch = temp;
+  }
+}
+
+// One pass over the sorted entries: each run of equal keys is a node, and a
+// stack of the open ancestors gives every node the end of its subtree
+static void LinearQuadTree_BuildNodes(LinearQuadTree* lqt) {
+  unsigned int stack[LINEAR_QUAD_TREE_BITS + 1];
+  int stack_size = 0;
+
+  lqt->num_nodes = 0;
+  for(unsigned int i = 0; i < lqt->num_lines; ++i) {
+    const uint64_t key = lqt->entries[i].key;
+    if(i > 0 && key == lqt->entries[i - 1].key) {
+      lqt->nodes[lqt->num_nodes - 1].count++;
+      continue;
+    }
+
+    LinearQuadNode* node = &lqt->nodes[lqt->num_nodes];
+    node->first       = i;
+    node->count       = 1;
+    node->level       = (int)(key & ((1 << LEVEL_BITS) - 1));
+    node->cell_x      = lqt->boxes[lqt->entries[i].line_id].min_x;
+    node->cell_y      = lqt->boxes[lqt->entries[i].line_id].min_y;
+    const int shift   = LINEAR_QUAD_TREE_BITS - node->level;
+    node->cell_x      = (node->cell_x >> shift) << shift;
+    node->cell_y      = (node->cell_y >> shift) << shift;
+    node->subtree_end = lqt->num_nodes + 1;
+
+    // anything on the stack that isn't an ancestor of this node is finished
+    while(stack_size > 0 && !LinearQuadTree_IsAncestor(&lqt->nodes[stack[stack_size - 1]], node)) {
+      lqt->nodes[stack[--stack_size]].subtree_end = lqt->num_nodes;
+    }
+    assert(stack_size <= LINEAR_QUAD_TREE_BITS);
+    stack[stack_size++] = lqt->num_nodes;
+    lqt->num_nodes++;
+  }
+  while(stack_size > 0) {
+    lqt->nodes[stack[--stack_size]].subtree_end = lqt->num_nodes;
+  }
+}
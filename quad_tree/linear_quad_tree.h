@@ -0,0 +1,67 @@
+#ifndef LINEAR_QUAD_TREE_H
+#define LINEAR_QUAD_TREE_H
+
+#include <stdint.h>
+
+#include "quad_tree.h"
+#include "../line_store.h"
+
+// The box is quantized to a 2^LINEAR_QUAD_TREE_BITS grid on each axis,
+// which is also the deepest level of the tree
+#define LINEAR_QUAD_TREE_BITS 16
+
+// Bounding box of a line's swept parallelogram in grid cells, inclusive
+typedef struct LinearQuadBox {
+  uint32_t min_x;
+  uint32_t min_y;
+  uint32_t max_x;
+  uint32_t max_y;
+} LinearQuadBox;
+
+// .key: Morton code of the cell's min corner << 5 | level
+//       sorting on this puts every cell right before its descendants
+typedef struct LinearQuadEntry {
+  uint64_t     key;
+  unsigned int line_id;
+} LinearQuadEntry;
+
+// One per distinct cell that holds lines
+// .first, .count:    the cell's lines are entries[first] .. entries[first + count - 1]
+// .subtree_end:      nodes[index + 1] .. nodes[subtree_end - 1] are the descendants
+// .cell_x, .cell_y:  min corner of the cell in grid cells
+// .level:            0 is the whole box, LINEAR_QUAD_TREE_BITS is a single grid cell
+typedef struct LinearQuadNode {
+  unsigned int first;
+  unsigned int count;
+  unsigned int subtree_end;
+  uint32_t     cell_x;
+  uint32_t     cell_y;
+  int          level;
+} LinearQuadNode;
+
+// Linear (pointerless) quad tree.
+// Each line goes in the smallest cell that holds its whole swept box. The lines are
+// sorted by the Morton code of that cell with a radix sort and the nodes come out of
+// one pass over the sorted codes, so a build is O(n) with no splits or reinserts.
+// Two lines can only overlap if one's cell is the other's cell or an ancestor of it.
+typedef struct LinearQuadTree {
+  // LinearQuadTree does not own this memory !!!
+  const LineStore* lines;
+
+  LinearQuadEntry* entries;  // sorted by key after a build
+  LinearQuadEntry* scratch;  // radix sort ping-pong buffer
+  LinearQuadBox*   boxes;    // indexed by line id
+  unsigned int     num_lines;
+
+  LinearQuadNode* nodes;
+  unsigned int    num_nodes;
+} LinearQuadTree;
+
+void LinearQuadTree_Init(LinearQuadTree* lqt, const LineStore* lines);
+void LinearQuadTree_Free(LinearQuadTree* lqt);
+void LinearQuadTree_Build(LinearQuadTree* lqt, const unsigned int num_lines, const double time_step);
+// Hands every pair of lines whose swept boxes overlap to callback exactly once, line_a < line_b
+void LinearQuadTree_ForEachCandidatePair(const LinearQuadTree* lqt, QuadTreePairCallback callback,
+                                         void* data);
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <math.h>
 #include "logging.h"
 #include "small_list.h"
 #include "free_list.h"
@@ -6,16 +7,43 @@
 #include "../line.h"
 #include "../intersection_detection.h"
 
+#ifdef __cilk
+#include <cilk/cilk.h>
+#else
+#define cilk_for for
+#define cilk_spawn
+#define cilk_sync
+#endif
+
+// Tolerance of the separating axis test in QuadTree_ClassifySwept, window units.
+// Rounding can't make it miss a quadrant the parallelogram touches.
+#define QUAD_TREE_SAT_SLACK 1e-6
+// stands in for the open outer side of quadrants on the root's edge
+#define QUAD_TREE_SAT_FAR 1e6
+
+// QuadTree_Build stops spawning below this many lines in a node
+#define QUAD_TREE_BUILD_GRAIN 512
+
+// QuadTree_BuildFromBoxes doesn't split nodes narrower than this many average boxes
+#define QUAD_TREE_BOX_SPLIT_WIDTHS 1
+
 // PRIVATE DECLARATIONS
 static void        QuadTree_QuadElementInsert(QuadTree* qt, const QuadNodeData node_data, 
-                                              const unsigned int line_id, const double time_step);
+                                              const unsigned int line_id);
 static SmallList   QuadTree_FindLeaves(const QuadTree* qt, const QuadNodeData node_data,
-		                       const unsigned int line_id, const double time_step);
-static BranchFlags QuadTree_PlaceLineInBranches(const Line* line, const QuadRect rect, 
-		                                const double time_step);
+		                       const unsigned int line_id);
 static void        QuadTree_InsertIntoLeaf(QuadTree* qt, const QuadNodeData node_data,
-		                           const unsigned int line_id, const double time_step);
+		                           const unsigned int line_id);
 static bool	       QuadTree_LineAlreadyQueried(SmallList const * sl, const unsigned int line_id);
+static SmallList   QuadTree_FindFrozenLeaves(const QuadTree* qt, const unsigned int line_id);
+static void        QuadTree_BuildSubtree(const QuadTree* qt, QuadBuildNode* node,
+                                         const QuadNodeData node_data, const int max_depth);
+static void        QuadTree_ReserveSweptLines(QuadTree* qt, const unsigned int num_lines);
+static void        QuadTree_BuildSwept(QuadTree* qt, const unsigned int num_lines,
+                                       const int max_depth);
+static void        QuadTree_InsertSwept(QuadTree* qt, const unsigned int line_id);
+static void        QuadTree_LayOutSubtree(QuadBuildNode* node, QuadNode* nodes, QuadElement* elements,
+                                          const int index, const int first_child, const int first_element);
 static void        QuadTree_PrintQuadNodeData(const QuadNodeData* element);
 static void        QuadTree_PrintQuadRect(const QuadRect* rect);
 //static void QuadTree_PrintElements(const QuadTree* qt, const unsigned int first_child_index, const int depth);
@@ -34,6 +62,70 @@ static inline QuadNodeData QuadTree_GetRootNodeData(const QuadTree* qt) {
   return rnd;
 }
 
+// Edges, bounds and separating axes of a swept parallelogram from its corners p1, p2, p1', p2'
+static inline void QuadTree_FinishSwept(QuadSweptLine* swept) {
+  // edges p1 p2, p1' p2', p1 p1', p2 p2'
+  static const int edge_a[4] = { 0, 2, 0, 1 };
+  static const int edge_b[4] = { 1, 3, 2, 3 };
+  for(int e = 0; e < 4; ++e) {
+    swept->dx[e]    = swept->x[edge_a[e]] - swept->x[edge_b[e]];
+    swept->dy[e]    = swept->y[edge_a[e]] - swept->y[edge_b[e]];
+    swept->slope[e] = swept->dy[e] / swept->dx[e];
+  }
+
+  swept->min_x = fmin(fmin(swept->x[0], swept->x[1]), fmin(swept->x[2], swept->x[3]));
+  swept->max_x = fmax(fmax(swept->x[0], swept->x[1]), fmax(swept->x[2], swept->x[3]));
+  swept->min_y = fmin(fmin(swept->y[0], swept->y[1]), fmin(swept->y[2], swept->y[3]));
+  swept->max_y = fmax(fmax(swept->y[0], swept->y[1]), fmax(swept->y[2], swept->y[3]));
+
+  // normals of edge p1 p2 and edge p1 p1', a degenerate edge gives a zero
+  // normal which every rectangle passes
+  for(int a = 0; a < 2; ++a) {
+    const int e = a == 0 ? 0 : 2;
+    swept->axis_x[a] = -swept->dy[e];
+    swept->axis_y[a] =  swept->dx[e];
+    double lo = swept->axis_x[a] * swept->x[0] + swept->axis_y[a] * swept->y[0];
+    double hi = lo;
+    for(int c = 1; c < 4; ++c) {
+      const double d = swept->axis_x[a] * swept->x[c] + swept->axis_y[a] * swept->y[c];
+      lo = fmin(lo, d);
+      hi = fmax(hi, d);
+    }
+    swept->axis_min[a] = lo;
+    swept->axis_max[a] = hi;
+  }
+}
+
+// Corners, edges and bounds of the line's swept parallelogram in window coordinates.
+// Kept to separate statements so the arithmetic matches Vec_add/Vec_multiply exactly.
+static inline void QuadTree_SweepLine(QuadTree* qt, const unsigned int line_id, const double time_step) {
+  const LineStore* lines = qt->lines;
+  QuadSweptLine* swept = &qt->swept_lines[line_id];
+  const double move_x = lines->vx[line_id] * time_step;
+  const double move_y = lines->vy[line_id] * time_step;
+  const double box_x[4] = { lines->p1x[line_id], lines->p2x[line_id],
+                            lines->p1x[line_id] + move_x, lines->p2x[line_id] + move_x };
+  const double box_y[4] = { lines->p1y[line_id], lines->p2y[line_id],
+                            lines->p1y[line_id] + move_y, lines->p2y[line_id] + move_y };
+  for(int c = 0; c < 4; ++c) {
+    boxToWindow(&swept->x[c], &swept->y[c], box_x[c], box_y[c]);
+  }
+  QuadTree_FinishSwept(swept);
+}
+
+// A box given in box coordinates standing in for the line's swept parallelogram,
+// corners (min, min), (max, min), (min, max), (max, max)
+static inline void QuadTree_SweepBox(QuadTree* qt, const unsigned int line_id,
+                                     const double min_x, const double max_x,
+                                     const double min_y, const double max_y) {
+  QuadSweptLine* swept = &qt->swept_lines[line_id];
+  boxToWindow(&swept->x[0], &swept->y[0], min_x, min_y);
+  boxToWindow(&swept->x[1], &swept->y[1], max_x, min_y);
+  boxToWindow(&swept->x[2], &swept->y[2], min_x, max_y);
+  boxToWindow(&swept->x[3], &swept->y[3], max_x, max_y);
+  QuadTree_FinishSwept(swept);
+}
+
 // Checks if line is ENTIRELY inside rectangle
 static inline bool QuadTree_LineInRect(const Line* line, const QuadRect* rect) {
   const double left_x  = (double)(rect->mid_x - rect->size_x);
@@ -53,6 +145,24 @@ static inline bool QuadTree_LineInRect(const Line* line, const QuadRect* rect) {
   return p1_in_rect && p2_in_rect;
 }
 
+// Builds the node data of child i (tl, bl, br, tr) of a branch
+static inline QuadNodeData QuadTree_GetChildNodeData(const QuadNodeData* parent, 
+                                                     const int first_child, const int i) {
+  const int child_size_x = parent->rect.size_x >> 1;
+  const int child_size_y = parent->rect.size_y >> 1;
+  const int sign_x[4] = { -1, -1, 1,  1 };
+  const int sign_y[4] = { -1,  1, 1, -1 };
+
+  QuadNodeData child;
+  child.rect.mid_x  = parent->rect.mid_x + sign_x[i] * child_size_x;
+  child.rect.mid_y  = parent->rect.mid_y + sign_y[i] * child_size_y;
+  child.rect.size_x = child_size_x;
+  child.rect.size_y = child_size_y;
+  child.index       = first_child + i;
+  child.depth       = parent->depth + 1;
+  return child;
+}
+
 // checks if line was already added to query list
 static inline bool QuadTree_LineAlreadyQueried(SmallList const * sl, unsigned int line_id) {
 	for(int i = 0; i < sl->num_elements; ++i) {
@@ -67,6 +177,7 @@ static inline bool QuadTree_LineAlreadyQueried(SmallList const * sl, unsigned in
 
 
 SmallList QuadTree_GetRectLineSegments(const QuadTree* qt) {
+	// Drawn also while paused, when no frame resets the arena, so keep these on the heap
 	SmallList rect_line_segments;
 	SmallList_Init(&rect_line_segments, sizeof(Line));
 
@@ -168,7 +279,7 @@ SmallList QuadTree_GetRectLineSegments(const QuadTree* qt) {
 }
 
 // PUBLIC
-void QuadTree_Init(QuadTree* qt, Line** lines, const int width, const int height, const int max_depth, const int max_elements) {
+void QuadTree_Init(QuadTree* qt, const LineStore* lines, FrameArena* arena, const int width, const int height, const int max_depth, const int max_elements) {
   assert(qt);
   assert(lines);
   assert(0 < width);
@@ -176,6 +287,7 @@ void QuadTree_Init(QuadTree* qt, Line** lines, const int width, const int height
   //assert(0 < max_depth);
    
   qt->lines = lines;
+  qt->arena = arena;
   SmallList_Init(&qt->quad_nodes, sizeof(QuadNode));
   FreeList_Init(&qt->quad_elements, sizeof(QuadElement));
 
@@ -194,6 +306,23 @@ void QuadTree_Init(QuadTree* qt, Line** lines, const int width, const int height
   qt->root_rect    = root_rect;
   qt->max_depth    = max_depth;
   qt->max_elements = max_elements;
+
+  qt->line_leaf_start          = NULL;
+  qt->line_stamp               = NULL;
+  qt->line_leaf_start_capacity = 0;
+  qt->line_leaves              = NULL;
+  qt->line_leaves_capacity     = 0;
+
+  qt->frozen                = false;
+  qt->frozen_nodes          = NULL;
+  qt->frozen_nodes_capacity = 0;
+  qt->num_frozen_nodes      = 0;
+  qt->frozen_lines          = NULL;
+  qt->frozen_lines_capacity = 0;
+
+  qt->swept_lines          = NULL;
+  qt->num_swept_lines      = 0;
+  qt->swept_lines_capacity = 0;
 }
 
 void QuadTree_Free(QuadTree* qt) {
@@ -204,11 +333,36 @@ void QuadTree_Free(QuadTree* qt) {
   qt->lines = NULL;
   SmallList_Free(&qt->quad_nodes);
   FreeList_Free(&qt->quad_elements);
+
+  free(qt->line_leaf_start);
+  free(qt->line_stamp);
+  free(qt->line_leaves);
+  qt->line_leaf_start          = NULL;
+  qt->line_stamp               = NULL;
+  qt->line_leaf_start_capacity = 0;
+  qt->line_leaves              = NULL;
+  qt->line_leaves_capacity     = 0;
+
+  free(qt->frozen_nodes);
+  free(qt->frozen_lines);
+  qt->frozen                = false;
+  qt->frozen_nodes          = NULL;
+  qt->frozen_nodes_capacity = 0;
+  qt->num_frozen_nodes      = 0;
+  qt->frozen_lines          = NULL;
+  qt->frozen_lines_capacity = 0;
+
+  free(qt->swept_lines);
+  qt->swept_lines          = NULL;
+  qt->num_swept_lines      = 0;
+  qt->swept_lines_capacity = 0;
 }
 
 void QuadTree_Clear(QuadTree* qt) {
   assert(qt);
 
+  qt->frozen = false;
+
   SmallList_Clear(&qt->quad_nodes);
   FreeList_Clear(&qt->quad_elements);
 
@@ -223,15 +377,175 @@ void QuadTree_Clear(QuadTree* qt) {
 void QuadTree_Insert(QuadTree* qt, const unsigned int line_id, const double time_step) {
   assert(qt);
 
-  QuadNodeData root_node_data = QuadTree_GetRootNodeData(qt);
-  QuadTree_QuadElementInsert(qt, root_node_data, line_id, time_step);
+  if(line_id >= qt->num_swept_lines) {
+    QuadTree_ReserveSweptLines(qt, line_id + 1);
+  }
+  QuadTree_SweepLine(qt, line_id, time_step);
+  QuadTree_InsertSwept(qt, line_id);
+}
+
+void QuadTree_SweepLines(QuadTree* qt, const unsigned int num_lines, const double time_step) {
+  assert(qt);
+
+  QuadTree_ReserveSweptLines(qt, num_lines);
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    QuadTree_SweepLine(qt, i, time_step);
+  }
+}
+
+// Builds the tree over the lines' swept shapes, splitting no node at max_depth or below
+static void QuadTree_BuildSwept(QuadTree* qt, const unsigned int num_lines, const int max_depth) {
+  assert(qt);
+
+  QuadTree_Clear(qt);
+  if(num_lines == 0) {
+    return;
+  }
+
+  QuadBuildNode root;
+  root.line_ids = malloc(num_lines * sizeof(unsigned int));
+  if(!root.line_ids) {
+    LOG("%s(): Couldn't malloc for build\n", __func__);
+    exit(1);
+  }
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    root.line_ids[i] = i;
+  }
+  root.num_lines = num_lines;
+  QuadTree_BuildSubtree(qt, &root, QuadTree_GetRootNodeData(qt), max_depth);
+
+  // now the sizes are known every subtree gets its own range of nodes and elements
+  SmallList_Resize(&qt->quad_nodes, root.num_nodes);
+  qt->quad_nodes.num_elements = root.num_nodes;
+  SmallList_Resize(&qt->quad_elements.sl, root.num_elements);
+  qt->quad_elements.sl.num_elements = root.num_elements;
+
+  QuadNode*    nodes    = SmallList_GetAtIndexRef(&qt->quad_nodes, 0);
+  QuadElement* elements = root.num_elements > 0 ? FreeList_GetAtIndexRef(&qt->quad_elements, 0) : NULL;
+  QuadTree_LayOutSubtree(&root, nodes, elements, 0, 1, 0);
+}
+
+void QuadTree_Build(QuadTree* qt, const unsigned int num_lines, const double time_step) {
+  assert(qt);
+
+  QuadTree_SweepLines(qt, num_lines, time_step);
+  QuadTree_BuildSwept(qt, num_lines, qt->max_depth);
+}
+
+void QuadTree_BuildFromBoxes(QuadTree* qt, const unsigned int num_lines,
+                             const double* min_x, const double* max_x,
+                             const double* min_y, const double* max_y) {
+  assert(qt);
+
+  QuadTree_ReserveSweptLines(qt, num_lines);
+  double total_extent = 0;
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    QuadTree_SweepBox(qt, i, min_x[i], max_x[i], min_y[i], max_y[i]);
+    const QuadSweptLine* swept = &qt->swept_lines[i];
+    total_extent += fmax(swept->max_x - swept->min_x, swept->max_y - swept->min_y);
+  }
+
+  // Boxes are far wider than lines, and where more than max_elements overlap no
+  // split can part them: splitting on down to max_depth only copies them into
+  // more leaves.  So stop once a node is narrower than QUAD_TREE_BOX_SPLIT_WIDTHS
+  // average boxes.
+  const double min_split_size = QUAD_TREE_BOX_SPLIT_WIDTHS * total_extent / num_lines;
+  int max_depth = 0;
+  while(max_depth < qt->max_depth &&
+        2 * (qt->root_rect.size_x >> max_depth) >= min_split_size &&
+        2 * (qt->root_rect.size_y >> max_depth) >= min_split_size) {
+    ++max_depth;
+  }
+  QuadTree_BuildSwept(qt, num_lines, max_depth);
+}
+
+void QuadTree_Freeze(QuadTree* qt) {
+  assert(qt);
+
+  const unsigned int num_nodes = qt->quad_nodes.num_elements;
+  // every element slot, live or free, bounds the number of leaf entries
+  const unsigned int max_lines = qt->quad_elements.sl.num_elements;
+  if(qt->frozen_nodes_capacity < num_nodes) {
+    free(qt->frozen_nodes);
+    qt->frozen_nodes_capacity = num_nodes * 2;
+    qt->frozen_nodes = malloc(qt->frozen_nodes_capacity * sizeof(QuadNode));
+  }
+  if(qt->frozen_lines_capacity < max_lines || qt->frozen_lines == NULL) {
+    free(qt->frozen_lines);
+    qt->frozen_lines_capacity = max_lines * 2 + 1;
+    qt->frozen_lines = malloc(qt->frozen_lines_capacity * sizeof(unsigned int));
+  }
+  if(!qt->frozen_nodes || !qt->frozen_lines) {
+    LOG("%s(): Couldn't malloc for frozen tree\n", __func__);
+    exit(1);
+  }
+
+  // source is the breadth first queue of live node indices, frozen node k is
+  // made from source[k] and a branch's children are queued together
+  SmallList source;
+  SmallList_InitArena(&source, sizeof(int), qt->arena);
+  SmallList_Resize(&source, num_nodes);
+  int root_index = 0;
+  SmallList_PushBack(&source, &root_index);
+
+  unsigned int num_lines = 0;
+  unsigned int k;
+  for(k = 0; k < source.num_elements; ++k) {
+    int live_index;
+    SmallList_GetAtIndexCopy(&source, k, &live_index);
+    const QuadNode* node = SmallList_GetAtIndexRef(&qt->quad_nodes, live_index);
+    QuadNode* frozen_node = &qt->frozen_nodes[k];
+    if(node->count == -1) {
+      frozen_node->first_child = (int)source.num_elements;
+      frozen_node->count       = -1;
+      for(int i = 0; i < 4; ++i) {
+        int child_index = node->first_child + i;
+        SmallList_PushBack(&source, &child_index);
+      }
+    }
+    else {
+      frozen_node->first_child = (int)num_lines;
+      frozen_node->count       = node->count;
+      int index = node->first_child;
+      while(index != -1) {
+        const QuadElement* element = FreeList_GetAtIndexRef(&qt->quad_elements, index);
+        qt->frozen_lines[num_lines++] = element->element_id;
+        index = element->next;
+      }
+    }
+  }
+  assert(k == num_nodes);
+
+  SmallList_Free(&source);
+  qt->num_frozen_nodes = k;
+  qt->frozen           = true;
 }
 
 SmallList QuadTree_QueryLines(const QuadTree* qt, const unsigned int line_id, const double time_step) {
+	if(qt->frozen) {
+		assert(line_id < qt->num_swept_lines);
+		SmallList leaves = QuadTree_FindFrozenLeaves(qt, line_id);
+		SmallList output;
+		SmallList_InitArena(&output, sizeof(unsigned int), qt->arena);
+		for(int l = 0; l < leaves.num_elements; ++l) {
+			int leaf_index;
+			SmallList_GetAtIndexCopy(&leaves, l, &leaf_index);
+			const QuadNode* leaf = &qt->frozen_nodes[leaf_index];
+			const unsigned int* ids = &qt->frozen_lines[leaf->first_child];
+			for(int j = 0; j < leaf->count; ++j) {
+				if(ids[j] != line_id && !QuadTree_LineAlreadyQueried(&output, ids[j])) {
+					SmallList_PushBack(&output, &ids[j]);
+				}
+			}
+		}
+		SmallList_Free(&leaves);
+		return output;
+	}
+
   	QuadNodeData root_node_data = QuadTree_GetRootNodeData(qt);
-	SmallList leaves = QuadTree_FindLeaves(qt, root_node_data, line_id, time_step);
+	SmallList leaves = QuadTree_FindLeaves(qt, root_node_data, line_id);
 	SmallList output;
-	SmallList_Init(&output, sizeof(unsigned int));
+	SmallList_InitArena(&output, sizeof(unsigned int), qt->arena);
 	while(0 < leaves.num_elements) {
 		QuadNodeData leaf;
 		SmallList_PopBackCopy(&leaves, &leaf);
@@ -254,29 +568,278 @@ SmallList QuadTree_QueryLines(const QuadTree* qt, const unsigned int line_id, co
 	return output;
 }
 
+void QuadTree_ForEachCandidatePair(QuadTree* qt, const unsigned int num_lines,
+                                   QuadTreePairCallback callback, void* data) {
+  assert(qt);
+  assert(callback);
+  assert(qt->frozen);
+
+  if(qt->line_leaf_start_capacity < num_lines + 1) {
+    free(qt->line_leaf_start);
+    free(qt->line_stamp);
+    qt->line_leaf_start_capacity = num_lines + 1;
+    qt->line_leaf_start = malloc(qt->line_leaf_start_capacity * sizeof(unsigned int));
+    qt->line_stamp      = malloc(qt->line_leaf_start_capacity * sizeof(unsigned int));
+    if(!qt->line_leaf_start || !qt->line_stamp) {
+      LOG("%s(): Couldn't malloc for line leaves\n", __func__);
+      exit(1);
+    }
+  }
+
+  const QuadNode*     nodes = qt->frozen_nodes;
+  const unsigned int* lines = qt->frozen_lines;
+
+  // count the leaves of each line into line_leaf_start[i + 1]
+  unsigned int* leaf_start = qt->line_leaf_start;
+  memset(leaf_start, 0, (num_lines + 1) * sizeof(unsigned int));
+  unsigned int num_entries = 0;
+  for(unsigned int n = 0; n < qt->num_frozen_nodes; ++n) {
+    const QuadNode* node = &nodes[n];
+    for(int j = 0; j < node->count; ++j) {
+      const unsigned int line = lines[node->first_child + j];
+      assert(line < num_lines);
+      leaf_start[line + 1]++;
+    }
+    num_entries += node->count > 0 ? node->count : 0;
+  }
+
+  if(qt->line_leaves_capacity < num_entries) {
+    free(qt->line_leaves);
+    qt->line_leaves_capacity = num_entries * 2;
+    qt->line_leaves = malloc(qt->line_leaves_capacity * sizeof(unsigned int));
+    if(!qt->line_leaves) {
+      LOG("%s(): Couldn't malloc for line leaves\n", __func__);
+      exit(1);
+    }
+  }
+
+  // fill with leaf_start[i] as the cursor for line i, leaves go in ascending order
+  // then shift back so leaf_start[i] is where line i begins again
+  for(unsigned int i = 1; i <= num_lines; ++i) {
+    leaf_start[i] += leaf_start[i - 1];
+  }
+  for(unsigned int n = 0; n < qt->num_frozen_nodes; ++n) {
+    const QuadNode* node = &nodes[n];
+    for(int j = 0; j < node->count; ++j) {
+      qt->line_leaves[leaf_start[lines[node->first_child + j]]++] = n;
+    }
+  }
+  for(unsigned int i = num_lines; i > 0; --i) {
+    leaf_start[i] = leaf_start[i - 1];
+  }
+  leaf_start[0] = 0;
+
+  // each line pairs with the higher lines in its leaves, a line met again in
+  // another shared leaf is already stamped with line_a + 1 and skipped
+  unsigned int* stamp = qt->line_stamp;
+  memset(stamp, 0, num_lines * sizeof(unsigned int));
+  for(unsigned int line_a = 0; line_a < num_lines; ++line_a) {
+    for(unsigned int k = leaf_start[line_a]; k < leaf_start[line_a + 1]; ++k) {
+      const QuadNode* leaf = &nodes[qt->line_leaves[k]];
+      const unsigned int* ids = &lines[leaf->first_child];
+      for(int j = 0; j < leaf->count; ++j) {
+        const unsigned int line_b = ids[j];
+        if(line_a < line_b && stamp[line_b] != line_a + 1) {
+          stamp[line_b] = line_a + 1;
+          callback(data, line_a, line_b);
+        }
+      }
+    }
+  }
+}
+
 // PRIVATE
+// Frozen leaves (indices into frozen_nodes) that the line's swept parallelogram reaches
+static SmallList QuadTree_FindFrozenLeaves(const QuadTree* qt, const unsigned int line_id) {
+  const QuadSweptLine* swept = &qt->swept_lines[line_id];
+  SmallList leaves;
+  SmallList to_process;
+  SmallList_InitArena(&leaves,     sizeof(int),          qt->arena);
+  SmallList_InitArena(&to_process, sizeof(QuadNodeData), qt->arena);
+
+  QuadNodeData root_node_data = QuadTree_GetRootNodeData(qt);
+  SmallList_PushBack(&to_process, &root_node_data);
+  while(0 < to_process.num_elements) {
+    QuadNodeData node_data;
+    SmallList_PopBackCopy(&to_process, &node_data);
+    const QuadNode* node = &qt->frozen_nodes[node_data.index];
+    if(node->count != -1) {
+      SmallList_PushBack(&leaves, &node_data.index);
+      continue;
+    }
+
+    const BranchFlags flags = QuadTree_ClassifySwept(qt, swept, &node_data);
+    const bool in_child[4] = { flags.tl, flags.bl, flags.br, flags.tr };
+    for(int i = 0; i < 4; ++i) {
+      if(in_child[i]) {
+        QuadNodeData child = QuadTree_GetChildNodeData(&node_data, node->first_child, i);
+        SmallList_PushBack(&to_process, &child);
+      }
+    }
+  }
+
+  SmallList_Free(&to_process);
+  return leaves;
+}
+
+// Inserts a line whose swept geometry is already up to date
+static void QuadTree_InsertSwept(QuadTree* qt, const unsigned int line_id) {
+  qt->frozen = false;
+
+  QuadTree_QuadElementInsert(qt, QuadTree_GetRootNodeData(qt), line_id);
+}
+
+static void QuadTree_ReserveSweptLines(QuadTree* qt, const unsigned int num_lines) {
+  if(qt->swept_lines_capacity < num_lines) {
+    const unsigned int capacity = num_lines * 2;
+    QuadSweptLine* swept_lines = realloc(qt->swept_lines, capacity * sizeof(QuadSweptLine));
+    if(!swept_lines) {
+      LOG("%s(): Couldn't realloc for swept lines\n", __func__);
+      exit(1);
+    }
+    qt->swept_lines          = swept_lines;
+    qt->swept_lines_capacity = capacity;
+  }
+  qt->num_swept_lines = num_lines;
+}
+
+// A node splits during serial insertion exactly when more than max_elements lines
+// reach it above max_depth, and which children a line reaches doesn't depend on
+// the order lines come in. So splitting each node's whole line set at once gives
+// the same tree.
+static void QuadTree_BuildSubtree(const QuadTree* qt, QuadBuildNode* node,
+                                  const QuadNodeData node_data, const int max_depth) {
+  node->children = NULL;
+  if(node->num_lines <= (unsigned int)qt->max_elements || node_data.depth >= max_depth) {
+    node->num_nodes    = 1;
+    node->num_elements = node->num_lines;
+    return;
+  }
+
+  BranchFlags* flags = malloc(node->num_lines * sizeof(BranchFlags));
+  node->children     = malloc(4 * sizeof(QuadBuildNode));
+  if(!flags || !node->children) {
+    LOG("%s(): Couldn't malloc for build\n", __func__);
+    exit(1);
+  }
+  cilk_for(unsigned int k = 0; k < node->num_lines; ++k) {
+    flags[k] = QuadTree_ClassifySwept(qt, &qt->swept_lines[node->line_ids[k]], &node_data);
+  }
+
+  unsigned int counts[4] = { 0, 0, 0, 0 };
+  for(unsigned int k = 0; k < node->num_lines; ++k) {
+    counts[0] += flags[k].tl;
+    counts[1] += flags[k].bl;
+    counts[2] += flags[k].br;
+    counts[3] += flags[k].tr;
+  }
+  for(int i = 0; i < 4; ++i) {
+    node->children[i].line_ids  = malloc((counts[i] > 0 ? counts[i] : 1) * sizeof(unsigned int));
+    node->children[i].num_lines = 0;
+    if(!node->children[i].line_ids) {
+      LOG("%s(): Couldn't malloc for build\n", __func__);
+      exit(1);
+    }
+  }
+  for(unsigned int k = 0; k < node->num_lines; ++k) {
+    const unsigned int line_id = node->line_ids[k];
+    const bool in_child[4] = { flags[k].tl, flags[k].bl, flags[k].br, flags[k].tr };
+    for(int i = 0; i < 4; ++i) {
+      if(in_child[i]) {
+        node->children[i].line_ids[node->children[i].num_lines++] = line_id;
+      }
+    }
+  }
+  free(flags);
+  free(node->line_ids);
+  node->line_ids = NULL;
+
+  // small subtrees aren't worth a spawn
+  if(node->num_lines >= QUAD_TREE_BUILD_GRAIN) {
+    for(int i = 0; i < 3; ++i) {
+      cilk_spawn QuadTree_BuildSubtree(qt, &node->children[i],
+                                       QuadTree_GetChildNodeData(&node_data, 0, i), max_depth);
+    }
+    QuadTree_BuildSubtree(qt, &node->children[3], QuadTree_GetChildNodeData(&node_data, 0, 3),
+                          max_depth);
+    cilk_sync;
+  }
+  else {
+    for(int i = 0; i < 4; ++i) {
+      QuadTree_BuildSubtree(qt, &node->children[i],
+                            QuadTree_GetChildNodeData(&node_data, 0, i), max_depth);
+    }
+  }
+
+  node->num_nodes    = 1;
+  node->num_elements = 0;
+  for(int i = 0; i < 4; ++i) {
+    node->num_nodes    += node->children[i].num_nodes;
+    node->num_elements += node->children[i].num_elements;
+  }
+}
+
+// Writes node at nodes[index]. Its 4 children go at first_child, followed by the
+// rest of each child's subtree in turn, and its leaves' elements from first_element on.
+// Frees the build node's memory as it goes.
+static void QuadTree_LayOutSubtree(QuadBuildNode* node, QuadNode* nodes, QuadElement* elements,
+                                   const int index, const int first_child, const int first_element) {
+  if(node->children == NULL) {
+    nodes[index].count       = (int)node->num_lines;
+    nodes[index].first_child = node->num_lines > 0 ? first_element : -1;
+    for(unsigned int k = 0; k < node->num_lines; ++k) {
+      elements[first_element + k].element_id = node->line_ids[k];
+      elements[first_element + k].next       = k + 1 < node->num_lines ? first_element + (int)k + 1 : -1;
+    }
+    free(node->line_ids);
+    return;
+  }
+
+  nodes[index].count       = -1;
+  nodes[index].first_child = first_child;
+
+  int child_first_child   = first_child + 4;
+  int child_first_element = first_element;
+  for(int i = 0; i < 4; ++i) {
+    QuadBuildNode* child = &node->children[i];
+    if(node->num_elements >= QUAD_TREE_BUILD_GRAIN) {
+      cilk_spawn QuadTree_LayOutSubtree(child, nodes, elements, first_child + i,
+                                        child_first_child, child_first_element);
+    }
+    else {
+      QuadTree_LayOutSubtree(child, nodes, elements, first_child + i,
+                             child_first_child, child_first_element);
+    }
+    child_first_child   += (int)child->num_nodes - 1;
+    child_first_element += (int)child->num_elements;
+  }
+  cilk_sync;
+  free(node->children);
+}
+
 static void QuadTree_QuadElementInsert(QuadTree* qt, const QuadNodeData node_data, 
-                                       const unsigned int line_id, const double time_step) {
+                                       const unsigned int line_id) {
   assert(qt);
 
-  SmallList leaves_to_insert = QuadTree_FindLeaves(qt, node_data, line_id, time_step);
+  SmallList leaves_to_insert = QuadTree_FindLeaves(qt, node_data, line_id);
   for(int i = 0; i < leaves_to_insert.num_elements; ++i) {
  	 QuadNodeData leaf;
 	 SmallList_GetAtIndexCopy(&leaves_to_insert, i, &leaf);
-	 QuadTree_InsertIntoLeaf(qt, leaf, line_id, time_step);
+	 QuadTree_InsertIntoLeaf(qt, leaf, line_id);
   }
 
   SmallList_Free(&leaves_to_insert);
 }
 
 static SmallList QuadTree_FindLeaves(const QuadTree* qt, const QuadNodeData node_data, 
-                                     const unsigned int line_id, const double time_step) {
+                                     const unsigned int line_id) {
   assert(qt);
 
+  const QuadSweptLine* swept = &qt->swept_lines[line_id];
   SmallList leaves;
   SmallList to_process_qnd;
-  SmallList_Init(&leaves,         sizeof(QuadNodeData));
-  SmallList_Init(&to_process_qnd, sizeof(QuadNodeData));
+  SmallList_InitArena(&leaves,         sizeof(QuadNodeData), qt->arena);
+  SmallList_InitArena(&to_process_qnd, sizeof(QuadNodeData), qt->arena);
   SmallList_PushBack(&to_process_qnd, &node_data);
   while(0 < to_process_qnd.num_elements) {
     QuadNodeData current_node_data;
@@ -288,8 +851,7 @@ static SmallList QuadTree_FindLeaves(const QuadTree* qt, const QuadNodeData node
 	    SmallList_PushBack(&leaves, &current_node_data);
     }
     else {
-      const Line* line = qt->lines[line_id];
-      BranchFlags flags = QuadTree_PlaceLineInBranches(line, current_node_data.rect, time_step);
+      BranchFlags flags = QuadTree_ClassifySwept(qt, swept, &current_node_data);
 
       const int child_size_x = current_node_data.rect.size_x >> 1;
       const int child_size_y = current_node_data.rect.size_y >> 1;
@@ -352,95 +914,136 @@ static SmallList QuadTree_FindLeaves(const QuadTree* qt, const QuadNodeData node
   return leaves;
 }
 
-static BranchFlags QuadTree_PlaceLineInBranches(const Line* line, const QuadRect rect, const double time_step) {
-	
-
-  // get a copy of current_line in box coordinates
-  // calculate all 4 lines of parallelogram
-  Line lines[4];
-  lines[0] = *line;
-  lines[1].p1 = Vec_add(lines[0].p1, Vec_multiply(lines[0].velocity, time_step));
-  lines[1].p2 = Vec_add(lines[0].p2, Vec_multiply(lines[0].velocity, time_step));
-  lines[2].p1 = lines[0].p1;
-  lines[2].p2 = lines[1].p1;
-  lines[3].p1 = lines[0].p2;
-  lines[3].p2 = lines[1].p2;
-
-  // convert all lines to window coordinates for placement in tree
-  for(int i = 0; i < 4; ++i) {
-    boxToWindow(&lines[i].p1.x, &lines[i].p1.y, lines[i].p1.x, lines[i].p1.y);
-    boxToWindow(&lines[i].p2.x, &lines[i].p2.y, lines[i].p2.x, lines[i].p2.y);
+BranchFlags QuadTree_ClassifySwept(const QuadTree* qt, const QuadSweptLine* swept,
+                                   const QuadNodeData* node_data) {
+  // Child rectangles come from halving sizes with >>, so a child's outer edge can sit up
+  // to 1 unit inside its parent's, up to depth units at depth. Quadrants are widened by
+  // that much so together they still cover everything that can reach this node. Outer
+  // edges on the root's edge are left open, lines sweep past the walls.
+  static const int sign_x[4] = { -1, -1, 1,  1 };
+  static const int sign_y[4] = { -1,  1, 1, -1 };
+  const QuadRect* rect = &node_data->rect;
+  const QuadRect* root = &qt->root_rect;
+  const int drift = node_data->depth;
+  const double left   = (rect->mid_x - rect->size_x - drift <= root->mid_x - root->size_x) ?
+                        -QUAD_TREE_SAT_FAR : rect->mid_x - rect->size_x - drift;
+  const double right  = (rect->mid_x + rect->size_x + drift >= root->mid_x + root->size_x) ?
+                        QUAD_TREE_SAT_FAR : rect->mid_x + rect->size_x + drift;
+  const double top    = (rect->mid_y - rect->size_y - drift <= root->mid_y - root->size_y) ?
+                        -QUAD_TREE_SAT_FAR : rect->mid_y - rect->size_y - drift;
+  const double bottom = (rect->mid_y + rect->size_y + drift >= root->mid_y + root->size_y) ?
+                        QUAD_TREE_SAT_FAR : rect->mid_y + rect->size_y + drift;
+
+  int hit[4];
+  for(int q = 0; q < 4; ++q) {
+    const double lo_x = sign_x[q] < 0 ? left : rect->mid_x;
+    const double hi_x = sign_x[q] < 0 ? rect->mid_x : right;
+    const double lo_y = sign_y[q] < 0 ? top : rect->mid_y;
+    const double hi_y = sign_y[q] < 0 ? rect->mid_y : bottom;
+    const double center_x = 0.5 * (lo_x + hi_x);
+    const double center_y = 0.5 * (lo_y + hi_y);
+    const double half_x = 0.5 * (hi_x - lo_x) + QUAD_TREE_SAT_SLACK;
+    const double half_y = 0.5 * (hi_y - lo_y) + QUAD_TREE_SAT_SLACK;
+
+    // the quadrant's axes
+    int overlap = (swept->min_x <= center_x + half_x) & (center_x - half_x <= swept->max_x) &
+                  (swept->min_y <= center_y + half_y) & (center_y - half_y <= swept->max_y);
+
+    // the parallelogram's axes, the quadrant projects to center +- radius
+    for(int a = 0; a < 2; ++a) {
+      const double center = swept->axis_x[a] * center_x + swept->axis_y[a] * center_y;
+      const double radius = fabs(swept->axis_x[a]) * half_x + fabs(swept->axis_y[a]) * half_y;
+      overlap &= (swept->axis_min[a] <= center + radius) & (center - radius <= swept->axis_max[a]);
+    }
+    hit[q] = overlap;
   }
 
+  BranchFlags res = {0};
+  res.tl = hit[0];
+  res.bl = hit[1];
+  res.br = hit[2];
+  res.tr = hit[3];
+  return res;
+}
+
+BranchFlags QuadTree_ClassifySweptBySlopes(const QuadSweptLine* swept, const QuadRect rect) {
+  // edges of the parallelogram as (first corner, second corner)
+  static const int edge_a[4] = { 0, 2, 0, 1 };
+  static const int edge_b[4] = { 1, 3, 2, 3 };
+  const double* x = swept->x;
+  const double* y = swept->y;
+
   BranchFlags res = {0};
   for(int i = 0; i < 4; ++i) {
     BranchFlags flags = {0};
-    double dy = lines[i].p1.y - lines[i].p2.y;
-    double dx = lines[i].p1.x - lines[i].p2.x;
+    const int a = edge_a[i];
+    const int b = edge_b[i];
+    const double dy = swept->dy[i];
+    const double dx = swept->dx[i];
     // vertical line
     if(dx == 0.0f) {
-          flags.tl = lines[i].p1.x <= rect.mid_x && (lines[i].p1.y <= rect.mid_y || lines[i].p2.y <= rect.mid_y);
-          flags.bl = lines[i].p1.x <= rect.mid_x && (lines[i].p1.y >= rect.mid_y || lines[i].p2.y >= rect.mid_y);
-          flags.br = lines[i].p1.x >= rect.mid_x && (lines[i].p1.y >= rect.mid_y || lines[i].p2.y >= rect.mid_y);
-          flags.tr = lines[i].p1.x >= rect.mid_x && (lines[i].p1.y <= rect.mid_y || lines[i].p2.y <= rect.mid_y);
+          flags.tl = x[a] <= rect.mid_x && (y[a] <= rect.mid_y || y[b] <= rect.mid_y);
+          flags.bl = x[a] <= rect.mid_x && (y[a] >= rect.mid_y || y[b] >= rect.mid_y);
+          flags.br = x[a] >= rect.mid_x && (y[a] >= rect.mid_y || y[b] >= rect.mid_y);
+          flags.tr = x[a] >= rect.mid_x && (y[a] <= rect.mid_y || y[b] <= rect.mid_y);
     }
     // horizontal line
     else if(dy == 0.0f) {
-          flags.tl = lines[i].p1.y <= rect.mid_y && (lines[i].p1.x <= rect.mid_x || lines[i].p2.x <= rect.mid_x);
-          flags.tr = lines[i].p1.y <= rect.mid_y && (lines[i].p1.x >= rect.mid_x || lines[i].p2.x >= rect.mid_x);
-          flags.bl = lines[i].p1.y >= rect.mid_y && (lines[i].p1.x <= rect.mid_x || lines[i].p2.x <= rect.mid_x);
-          flags.br = lines[i].p1.y >= rect.mid_y && (lines[i].p1.x >= rect.mid_x || lines[i].p2.x >= rect.mid_x);
+          flags.tl = y[a] <= rect.mid_y && (x[a] <= rect.mid_x || x[b] <= rect.mid_x);
+          flags.tr = y[a] <= rect.mid_y && (x[a] >= rect.mid_x || x[b] >= rect.mid_x);
+          flags.bl = y[a] >= rect.mid_y && (x[a] <= rect.mid_x || x[b] <= rect.mid_x);
+          flags.br = y[a] >= rect.mid_y && (x[a] >= rect.mid_x || x[b] >= rect.mid_x);
     }
     else {
       // find where our line would intersect the 
       // left, middle, and right of the parent node
-      double slope = dy / dx;
+      double slope = swept->slope[i];
       double l_x_rect = (double)(rect.mid_x - rect.size_x);
       double m_x_rect = (double)(rect.mid_x);
       double r_x_rect = (double)(rect.mid_x + rect.size_x);
-      double l_y_line = slope*(l_x_rect - lines[i].p1.x) + lines[i].p1.y;
-      double m_y_line = slope*(m_x_rect - lines[i].p1.x) + lines[i].p1.y;
-      double r_y_line = slope*(r_x_rect - lines[i].p1.x) + lines[i].p1.y;
+      double l_y_line = slope*(l_x_rect - x[a]) + y[a];
+      double m_y_line = slope*(m_x_rect - x[a]) + y[a];
+      double r_y_line = slope*(r_x_rect - x[a]) + y[a];
       double t_y_rect = (double)(rect.mid_y - rect.size_y);
       double m_y_rect = (double)(rect.mid_y);
       double b_y_rect = (double)(rect.mid_y + rect.size_y);
       if(slope > 0) {
       	flags.tl = (l_y_line <= m_y_rect) &&
       		   (m_y_line >= t_y_rect) &&
-      		   (lines[i].p1.x <= m_x_rect || lines[i].p2.x <= m_x_rect) &&
-      		   (lines[i].p1.y <= m_y_rect || lines[i].p2.y <= m_y_rect);
+      		   (x[a] <= m_x_rect || x[b] <= m_x_rect) &&
+      		   (y[a] <= m_y_rect || y[b] <= m_y_rect);
       		
       	flags.bl = (m_y_line >= m_y_rect) &&
-      		   (lines[i].p1.x <= m_x_rect || lines[i].p2.x <= m_x_rect) &&
-      		   (lines[i].p1.y >= m_y_rect || lines[i].p2.y >= m_y_rect);
+      		   (x[a] <= m_x_rect || x[b] <= m_x_rect) &&
+      		   (y[a] >= m_y_rect || y[b] >= m_y_rect);
       		
       	flags.br = (m_y_line <= b_y_rect) &&
       		   (r_y_line >= m_y_rect) &&
-      		   (lines[i].p1.x >= m_x_rect || lines[i].p2.x >= m_x_rect) &&
-      		   (lines[i].p1.y >= m_y_rect || lines[i].p2.y >= m_y_rect);
+      		   (x[a] >= m_x_rect || x[b] >= m_x_rect) &&
+      		   (y[a] >= m_y_rect || y[b] >= m_y_rect);
       		
       	flags.tr = (m_y_line <= m_y_rect) &&
-      		   (lines[i].p1.x >= m_x_rect || lines[i].p2.x >= m_x_rect) &&
-      		   (lines[i].p1.y <= m_y_rect || lines[i].p2.y <= m_y_rect);
+      		   (x[a] >= m_x_rect || x[b] >= m_x_rect) &&
+      		   (y[a] <= m_y_rect || y[b] <= m_y_rect);
       }
       else {
       	flags.tl = (m_y_line <= m_y_rect) &&
-      		   (lines[i].p1.x <= m_x_rect || lines[i].p2.x <= m_x_rect) &&
-      		   (lines[i].p1.y <= m_y_rect || lines[i].p2.y <= m_y_rect);
+      		   (x[a] <= m_x_rect || x[b] <= m_x_rect) &&
+      		   (y[a] <= m_y_rect || y[b] <= m_y_rect);
       
       	flags.bl = (l_y_line >= m_y_rect) &&
       		   (m_y_line <= b_y_rect) &&
-      		   (lines[i].p1.x <= m_x_rect || lines[i].p2.x <= m_x_rect) &&
-      		   (lines[i].p1.y >= m_y_rect || lines[i].p2.y >= m_y_rect);
+      		   (x[a] <= m_x_rect || x[b] <= m_x_rect) &&
+      		   (y[a] >= m_y_rect || y[b] >= m_y_rect);
       		
       	flags.br = (m_y_line >= m_y_rect) &&
-      		   (lines[i].p1.x >= m_x_rect || lines[i].p2.x >= m_x_rect) &&
-      		   (lines[i].p1.y >= m_y_rect || lines[i].p2.y >= m_y_rect);
+      		   (x[a] >= m_x_rect || x[b] >= m_x_rect) &&
+      		   (y[a] >= m_y_rect || y[b] >= m_y_rect);
       
       	flags.tr = (m_y_line >= t_y_rect) &&
       		   (r_y_line <= m_y_rect) &&
-      		   (lines[i].p1.x >= m_x_rect || lines[i].p2.x >= m_x_rect) &&
-      		   (lines[i].p1.y <= m_y_rect || lines[i].p2.y <= m_y_rect);
+      		   (x[a] >= m_x_rect || x[b] >= m_x_rect) &&
+      		   (y[a] <= m_y_rect || y[b] <= m_y_rect);
       }
     }
 
@@ -454,7 +1057,7 @@ static BranchFlags QuadTree_PlaceLineInBranches(const Line* line, const QuadRect
 }
 
 static void QuadTree_InsertIntoLeaf(QuadTree* qt, const QuadNodeData node_data, 
-		                    const unsigned int line_id, const double time_step) {
+		                    const unsigned int line_id) {
   assert(qt);
 
   // grab ref to QuadNode leaf where we are inserting
@@ -473,7 +1076,7 @@ static void QuadTree_InsertIntoLeaf(QuadTree* qt, const QuadNodeData node_data,
      (node_data.depth < qt->max_depth)) {
     // Pop all element_nodes off of this node
     SmallList quad_elements_temp;
-    SmallList_Init(&quad_elements_temp, sizeof(QuadElement));
+    SmallList_InitArena(&quad_elements_temp, sizeof(QuadElement), qt->arena);
     QuadElement* element;
     int index;
     while(quad_node->first_child != -1) {
@@ -502,7 +1105,7 @@ static void QuadTree_InsertIntoLeaf(QuadTree* qt, const QuadNodeData node_data,
     QuadElement element_to_reinsert;
     while(0 < quad_elements_temp.num_elements) {
     	SmallList_PopBackCopy(&quad_elements_temp, &element_to_reinsert);
-        QuadTree_QuadElementInsert(qt, node_data, element_to_reinsert.element_id, time_step);
+        QuadTree_QuadElementInsert(qt, node_data, element_to_reinsert.element_id);
     }
 
     SmallList_Free(&quad_elements_temp);
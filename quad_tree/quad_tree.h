@@ -3,7 +3,9 @@
 
 #include "small_list.h"
 #include "free_list.h"
+#include "frame_arena.h"
 #include "../line.h"
+#include "../line_store.h"
 
 // - used for describing which child nodes
 //   an element belongs to
@@ -55,9 +57,51 @@ typedef struct QuadNodeData {
   int depth;
 } QuadNodeData;
 
+// A line's swept parallelogram (the line now and after one time step) in window coordinates,
+// worked out once per frame so the tree doesn't redo it at every node it visits
+// .x, .y:      corners p1, p2, p1 + v*t, p2 + v*t
+// .dx, .dy:    edges p1 p2, p1' p2', p1 p1', p2 p2' as first corner - second corner
+// .slope:      dy / dx of each edge, only meaningful when dx != 0
+// .min_*/max_*: bounding box of the corners
+// .axis_*:     normals of the line and of its motion, the parallelogram's own separating
+//              axes, with the range of the corners projected onto each
+typedef struct QuadSweptLine {
+  double x[4];
+  double y[4];
+  double dx[4];
+  double dy[4];
+  double slope[4];
+  double min_x;
+  double min_y;
+  double max_x;
+  double max_y;
+  double axis_x[2];
+  double axis_y[2];
+  double axis_min[2];
+  double axis_max[2];
+} QuadSweptLine;
+
+// Temporary tree made by QuadTree_Build before it is laid out in quad_nodes/quad_elements
+// .line_ids:     lines that reach this node, freed once they are handed to the children
+// .children:     the 4 children (tl, bl, br, tr), NULL if this is a leaf
+// .num_nodes:    nodes in this subtree, this one included
+// .num_elements: QuadElements in the leaves of this subtree
+typedef struct QuadBuildNode {
+  unsigned int*          line_ids;
+  unsigned int           num_lines;
+  struct QuadBuildNode*  children;
+  unsigned int           num_nodes;
+  unsigned int           num_elements;
+} QuadBuildNode;
+
 typedef struct QuadTree {
   // QuadTree does not own this memory !!!
-  Line** lines;
+  // lines are looked up by id
+  const LineStore* lines;
+
+  // Temporary lists made while inserting and querying draw from this, NULL to use the heap.
+  // QuadTree does not own this memory !!!
+  FrameArena* arena;
 
   // Stores each branch/leaf in tree. 4 sub rects are 4 in a row.
   SmallList quad_nodes;   // <QuadNode>
@@ -73,14 +117,77 @@ typedef struct QuadTree {
 
   // Max elements in leaf before split
   int max_elements;
+
+  // Read only copy of the tree made by QuadTree_Freeze, dropped by anything that changes the tree.
+  // .frozen_nodes: the nodes in breadth first order, so siblings and then whole levels are
+  //                next to each other. A branch's .first_child indexes frozen_nodes, a
+  //                leaf's indexes frozen_lines
+  // .frozen_lines: the line ids of every leaf, each leaf's ids contiguous
+  bool          frozen;
+  QuadNode*     frozen_nodes;
+  unsigned int  frozen_nodes_capacity;
+  unsigned int  num_frozen_nodes;
+  unsigned int* frozen_lines;
+  unsigned int  frozen_lines_capacity;
+
+  // Swept geometry of lines 0 .. num_swept_lines - 1 for the current frame, see QuadTree_SweepLines
+  QuadSweptLine* swept_lines;
+  unsigned int   num_swept_lines;
+  unsigned int   swept_lines_capacity;
+
+  // Scratch for QuadTree_ForEachCandidatePair, grown as needed
+  // the leaves of line i are line_leaves[line_leaf_start[i]] .. line_leaves[line_leaf_start[i + 1] - 1],
+  // as indices into the breadth first frozen_nodes. line_stamp marks lines already paired with the current line
+  unsigned int* line_leaf_start;
+  unsigned int* line_stamp;
+  unsigned int  line_leaf_start_capacity;
+  unsigned int* line_leaves;
+  unsigned int  line_leaves_capacity;
 } QuadTree;
 
-void QuadTree_Init(QuadTree* qt, Line** lines, const int width, const int height, 
+// Called once for every pair of lines that share a leaf, line_a < line_b
+typedef void (*QuadTreePairCallback)(void* data, const unsigned int line_a, const unsigned int line_b);
+
+void QuadTree_Init(QuadTree* qt, const LineStore* lines, FrameArena* arena, const int width, const int height, 
 		   const int max_depth, const int max_elements);
 void QuadTree_Free(QuadTree* qt);
 void QuadTree_Clear(QuadTree* qt);
 void QuadTree_Insert(QuadTree* qt, const unsigned int line_id, const double time_step);
+// Works out the swept geometry of lines 0 .. num_lines - 1 in one pass. QuadTree_Build does
+// this itself, QuadTree_Insert refreshes just the line it inserts.
+void QuadTree_SweepLines(QuadTree* qt, const unsigned int num_lines, const double time_step);
+// Clears the tree and bulk builds it from lines 0 .. num_lines - 1. The lines are split by
+// quadrant top down and the four quadrants are built in parallel, then laid out in
+// quad_nodes/quad_elements. Gives the same leaves holding the same lines as inserting
+// the lines one by one, only node numbering and the order inside a leaf differ.
+void QuadTree_Build(QuadTree* qt, const unsigned int num_lines, const double time_step);
+// QuadTree_Build with each line's swept parallelogram replaced by a box, in box coordinates.
+// Lines then share a leaf whenever their boxes could overlap.
+void QuadTree_BuildFromBoxes(QuadTree* qt, const unsigned int num_lines,
+                             const double* min_x, const double* max_x,
+                             const double* min_y, const double* max_y);
+// Packs the tree into frozen_nodes/frozen_lines so queries read leaves sequentially instead of
+// following QuadElement chains around the FreeList. Call after building the tree for the frame.
+void QuadTree_Freeze(QuadTree* qt);
+// Children (tl, bl, br, tr) of the node reached by the swept parallelogram. Separating axis
+// test against all four quadrants at once: the quadrant axes and the normals of the line and
+// of its motion. Exact up to rounding (quadrants are widened by QUAD_TREE_SAT_SLACK and by the
+// drift of integer child sizes, and left open past the root) and without data dependent branches.
+BranchFlags QuadTree_ClassifySwept(const QuadTree* qt, const QuadSweptLine* swept,
+                                   const QuadNodeData* node_data);
+// The older classifier comparing edge slopes against the mid lines. Takes in quadrants the
+// parallelogram misses. Only kept so classify_check can compare the two.
+BranchFlags QuadTree_ClassifySweptBySlopes(const QuadSweptLine* swept, const QuadRect rect);
+// Uses the swept geometry from the last build or update, time_step is not looked at again.
+// Not safe to call from several threads at once when the tree has an arena
 SmallList QuadTree_QueryLines(const QuadTree* qt, const unsigned int line_id, const double time_step);
+// Hands each unordered pair of lines sharing a leaf to callback exactly once, in order of line_a.
+// The leaves are walked once to find the leaves of every line, then each line is paired with
+// the higher lines in its leaves without descending the tree or searching for duplicates.
+// num_lines must cover every line id in the tree, and the tree must be frozen
+void QuadTree_ForEachCandidatePair(QuadTree* qt, const unsigned int num_lines,
+                                   QuadTreePairCallback callback, void* data);
+// Heap backed, the caller frees the list with SmallList_Free
 SmallList QuadTree_GetRectLineSegments(const QuadTree* qt);
 //void QuadTree_PrintInfo(const QuadTree* qt);
 //void QuadTree_PrintEntireTree(const QuadTree* qt);
@@ -13,6 +13,13 @@ void SmallList_Init(SmallList* sl, unsigned int element_bytes) {
   sl->num_elements = 0;
   sl->element_bytes = element_bytes;
   sl->capacity = BUFFER_BYTES / element_bytes;
+  sl->arena = NULL;
+}
+
+// arena can be NULL, then this is the same as SmallList_Init
+void SmallList_InitArena(SmallList* sl, unsigned int element_bytes, FrameArena* arena) {
+  SmallList_Init(sl, element_bytes);
+  sl->arena = arena;
 }
 
 void SmallList_PushBack(SmallList* sl, const void* element) {
@@ -73,14 +80,15 @@ void SmallList_Resize(SmallList* sl, const unsigned int new_cap) {
   assert(sl);
 
   if(new_cap > sl->capacity) {
-    void* new_data = calloc(new_cap, sl->element_bytes);
+    void* new_data = sl->arena ? FrameArena_Alloc(sl->arena, (size_t)new_cap * sl->element_bytes)
+                               : calloc(new_cap, sl->element_bytes);
     if(!new_data) {
       LOG("%s(): Couldn't calloc on resize\n", __func__);
       return;
     }
     void* begin = SmallList_GetStartAddress(sl);
     memcpy(new_data, begin, (sl->num_elements * sl->element_bytes));
-    if(sl->data) {
+    if(sl->data && !sl->arena) {
       free(sl->data);
       //LOG("%s(): %p address freed...\n", __func__, sl->data);
     }
@@ -102,7 +110,7 @@ void SmallList_Clear(SmallList* sl) {
 void SmallList_Free(SmallList* sl) {
   assert(sl);
 
-  if(sl->data) {
+  if(sl->data && !sl->arena) {
     free(sl->data);
     //LOG("%s(): %p address freed...\n", __func__, sl->data);
   }
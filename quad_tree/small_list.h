@@ -7,6 +7,8 @@
 #include <string.h>
 #include <assert.h>
 
+#include "frame_arena.h"
+
 #define BUFFER_BYTES 256
 
 typedef struct SmallList {
@@ -15,9 +17,13 @@ typedef struct SmallList {
   unsigned int num_elements;
   unsigned int element_bytes;
   unsigned int capacity;
+  // if set, growing past the buffer draws from this arena instead of calloc
+  // and the memory is given back when the arena is reset, not by SmallList_Free
+  FrameArena* arena;
 } SmallList;
 
 void  SmallList_Init(SmallList* sl, const unsigned int element_bytes);
+void  SmallList_InitArena(SmallList* sl, const unsigned int element_bytes, FrameArena* arena);
 void  SmallList_PushBack(SmallList* sl, const void* element);
 void  SmallList_PopBackCopy(SmallList* sl, void* element_out);
 
@@ -0,0 +1,42 @@
+/**
+ * scene_convert.c -- converts a text .in input into a binary scene file
+ *
+ * The input is loaded with the regular text loader, so the scene file holds
+ * exactly the box coordinates the simulation would have started from.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./line_demo.h"
+#include "./scene_file.h"
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    printf("Usage: %s <input.in> <output%s>\n", argv[0], SCENE_FILE_EXTENSION);
+    exit(-1);
+  }
+  if (SceneFile_isSceneFile(argv[1])) {
+    fprintf(stderr, "%s is already a scene file\n", argv[1]);
+    exit(1);
+  }
+  if (!SceneFile_isSceneFile(argv[2])) {
+    fprintf(stderr, "Output must end in %s\n", SCENE_FILE_EXTENSION);
+    exit(1);
+  }
+
+  LineDemo* lineDemo = LineDemo_new();
+  LineDemo_setInputFile(argv[1]);
+  LineDemo_initLine(lineDemo, BROAD_PHASE_N2);
+
+  const unsigned int numOfLines = LineDemo_getNumOfLines(lineDemo);
+  const bool ok = SceneFile_write(argv[2],
+                                  &lineDemo->collisionWorld->lineStore,
+                                  numOfLines);
+  if (ok) {
+    printf("Wrote %u lines to %s\n", numOfLines, argv[2]);
+  }
+
+  LineDemo_delete(lineDemo);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#include "./scene_file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The color array is used in place, so it has to match the on-disk int32_t.
+typedef char SceneFile_colorIsInt32[sizeof(Color) == sizeof(int32_t) ? 1 : -1];
+
+#define SCENE_FILE_NUM_DOUBLE_ARRAYS 6
+
+static size_t SceneFile_bytes(const unsigned int numLines) {
+  return sizeof(SceneFileHeader)
+         + (size_t) numLines * SCENE_FILE_NUM_DOUBLE_ARRAYS * sizeof(box_dimension)
+         + (size_t) numLines * sizeof(int32_t);
+}
+
+bool SceneFile_isSceneFile(const char* path) {
+  const size_t length = strlen(path);
+  const size_t extensionLength = strlen(SCENE_FILE_EXTENSION);
+  return length >= extensionLength
+         && strcmp(path + length - extensionLength, SCENE_FILE_EXTENSION) == 0;
+}
+
+bool SceneFile_map(const char* path, LineStore* store, unsigned int* numLines) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Input file not found (%s)\n", path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SceneFileHeader)) {
+    fprintf(stderr, "Scene file too short (%s)\n", path);
+    close(fd);
+    return false;
+  }
+
+  // PROT_WRITE on a private mapping of a read-only fd is fine, the lines move
+  // in copy-on-write pages and the file is never touched.
+  void* mapping = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                       fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Couldn't map scene file (%s)\n", path);
+    return false;
+  }
+
+  const SceneFileHeader* header = mapping;
+  if (memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(header->magic)) != 0
+      || header->version != SCENE_FILE_VERSION
+      || SceneFile_bytes(header->numLines) != (size_t) st.st_size) {
+    fprintf(stderr, "Not a valid scene file (%s)\n", path);
+    munmap(mapping, st.st_size);
+    return false;
+  }
+
+  const unsigned int n = header->numLines;
+  box_dimension* arrays = (box_dimension*) ((char*) mapping + sizeof(SceneFileHeader));
+  store->p1x = arrays + 0 * (size_t) n;
+  store->p1y = arrays + 1 * (size_t) n;
+  store->p2x = arrays + 2 * (size_t) n;
+  store->p2y = arrays + 3 * (size_t) n;
+  store->vx = arrays + 4 * (size_t) n;
+  store->vy = arrays + 5 * (size_t) n;
+  store->color = (Color*) (arrays + SCENE_FILE_NUM_DOUBLE_ARRAYS * (size_t) n);
+  store->capacity = n;
+  store->mapping = mapping;
+  store->mappingBytes = st.st_size;
+  // the shapes aren't in the file, they are worked out at load
+  if (!LineStore_initShapes(store, n)) {
+    fprintf(stderr, "Couldn't allocate line shapes (%s)\n", path);
+    LineStore_free(store);
+    return false;
+  }
+  *numLines = n;
+  return true;
+}
+
+bool SceneFile_write(const char* path, const LineStore* store,
+                     const unsigned int numLines) {
+  FILE* fout = fopen(path, "wb");
+  if (fout == NULL) {
+    fprintf(stderr, "Couldn't open %s for writing\n", path);
+    return false;
+  }
+
+  SceneFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+  header.version = SCENE_FILE_VERSION;
+  header.numLines = numLines;
+
+  const box_dimension* arrays[SCENE_FILE_NUM_DOUBLE_ARRAYS] = {
+    store->p1x, store->p1y, store->p2x, store->p2y, store->vx, store->vy
+  };
+  bool ok = fwrite(&header, sizeof(header), 1, fout) == 1;
+  for (unsigned int a = 0; ok && a < SCENE_FILE_NUM_DOUBLE_ARRAYS; a++) {
+    ok = fwrite(arrays[a], sizeof(box_dimension), numLines, fout) == numLines;
+  }
+  for (unsigned int i = 0; ok && i < numLines; i++) {
+    const int32_t color = store->color[i];
+    ok = fwrite(&color, sizeof(color), 1, fout) == 1;
+  }
+  if (fclose(fout) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "Couldn't write scene file %s\n", path);
+  }
+  return ok;
+}
@@ -0,0 +1,44 @@
+// scene_file.h -- binary scene files that are mapped straight into a LineStore
+#ifndef SCENEFILE_H_
+#define SCENEFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "./line_store.h"
+
+// Inputs with this extension are loaded as scene files, anything else is
+// parsed as the text .in format.
+#define SCENE_FILE_EXTENSION ".bin"
+
+#define SCENE_FILE_MAGIC "LINESCN"
+#define SCENE_FILE_VERSION 1
+
+// Layout, native byte order:
+//   SceneFileHeader
+//   p1x[numLines] p1y[numLines] p2x[numLines] p2y[numLines]   box coordinates
+//   vx[numLines]  vy[numLines]                                box velocity
+//   color[numLines]                                           int32_t, a Color
+// Each array is the LineStore array of the same name, so loading is just
+// pointing the store into the mapping.  The header keeps the doubles 8-byte
+// aligned.
+typedef struct SceneFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t numLines;
+} SceneFileHeader;
+
+// True if path ends with SCENE_FILE_EXTENSION.
+bool SceneFile_isSceneFile(const char* path);
+
+// Maps the file copy-on-write and points the store's arrays into it, no line
+// is copied.  Writes from the simulation go to private pages and never reach
+// the file.  Returns false (with a message on stderr) if the file can't be
+// mapped or is not a valid scene file.
+bool SceneFile_map(const char* path, LineStore* store, unsigned int* numLines);
+
+// Writes the first numLines lines of the store as a scene file.
+bool SceneFile_write(const char* path, const LineStore* store,
+                     const unsigned int numLines);
+
+#endif  // SCENEFILE_H_
@@ -30,6 +30,7 @@
 #include "./line.h"
 #include "./line_demo.h"
 #include "./cilktool.h"
+#include "./phase_timing.h"
 
 // The PROFILE_BUILD preprocessor define is used to indicate we are building for
 // profiling, so don't include any graphics or Cilk functions.
@@ -60,9 +61,12 @@ int main(int argc, char *argv[]) {
   unsigned int numFrames = 1;
   extern int optind;
 
-  bool quad_tree_flag = false;
+  BroadPhase broad_phase = BROAD_PHASE_N2;
+  bool parallel_flag = false;
+  bool parallel_solver_flag = false;
+  bool pair_cache_flag = false;
   // Process command line options.
-  while ((optchar = getopt(argc, argv, "gq")) != -1) {
+  while ((optchar = getopt(argc, argv, "gqpuslbcv")) != -1) {
     switch (optchar) {
       case 'g':
 #ifndef PROFILE_BUILD
@@ -71,7 +75,35 @@ int main(int argc, char *argv[]) {
         break;
       case 'q':
       {
-        quad_tree_flag = true;
+        broad_phase = BROAD_PHASE_QUAD_TREE;
+      } break;
+      case 'u':
+      {
+        broad_phase = BROAD_PHASE_GRID;
+      } break;
+      case 's':
+      {
+        broad_phase = BROAD_PHASE_SWEEP;
+      } break;
+      case 'l':
+      {
+        broad_phase = BROAD_PHASE_LINEAR_QUAD_TREE;
+      } break;
+      case 'b':
+      {
+        broad_phase = BROAD_PHASE_BVH;
+      } break;
+      case 'p':
+      {
+        parallel_flag = true;
+      } break;
+      case 'c':
+      {
+        parallel_solver_flag = true;
+      } break;
+      case 'v':
+      {
+        pair_cache_flag = true;
       } break;
       default:
         printf("Ignoring unrecognized option: %c\n", optchar);
@@ -87,8 +119,16 @@ int main(int argc, char *argv[]) {
 
   // Check to make sure number of arguments is correct.
   if (remaining_args < 1) {
-    printf("Usage: %s [-g] <numFrames> [inputfile]\n", argv[0]);
+    printf("Usage: %s [-g] [-q] [-p] [-u] [-s] [-l] [-b] [-c] [-v] <numFrames> [inputfile]\n", argv[0]);
     printf("  -g : show graphics\n");
+    printf("  -q : use quad tree\n");
+    printf("  -p : detect intersections in parallel\n");
+    printf("  -u : use uniform grid\n");
+    printf("  -s : use sort and sweep\n");
+    printf("  -l : use linear (Morton ordered) quad tree\n");
+    printf("  -b : use bounding volume hierarchy, refit each frame\n");
+    printf("  -c : solve collisions in parallel, in batches that share no line\n");
+    printf("  -v : keep candidate pairs between frames until a line leaves its fattened box\n");
     exit(-1);
   }
 
@@ -102,17 +142,41 @@ int main(int argc, char *argv[]) {
   }
   printf("Input file path is: %s\n", input_file_path);
 
-  if(quad_tree_flag) {
+  if(broad_phase == BROAD_PHASE_GRID) {
+    printf("using uniform grid\n");
+  }
+  else if(broad_phase == BROAD_PHASE_SWEEP) {
+    printf("using sort and sweep\n");
+  }
+  else if(broad_phase == BROAD_PHASE_LINEAR_QUAD_TREE) {
+    printf("using linear quad_tree\n");
+  }
+  else if(broad_phase == BROAD_PHASE_BVH) {
+    printf("using bvh\n");
+  }
+  else if(broad_phase == BROAD_PHASE_QUAD_TREE) {
     printf("using quad_tree\n");
   }
   else {
     printf("using n^2\n");
   }
+  if(parallel_flag) {
+    printf("using parallel detection\n");
+  }
+  if(parallel_solver_flag) {
+    printf("using parallel solver\n");
+  }
+  if(pair_cache_flag) {
+    printf("using pair cache\n");
+  }
 
   // Create and initialize the Line simulation environment.
   LineDemo *lineDemo = LineDemo_new();
   LineDemo_setInputFile(input_file_path);
-  LineDemo_initLine(lineDemo, quad_tree_flag);
+  LineDemo_initLine(lineDemo, broad_phase);
+  lineDemo->collisionWorld->using_parallel_detection = parallel_flag;
+  lineDemo->collisionWorld->using_parallel_solver = parallel_solver_flag;
+  lineDemo->collisionWorld->using_pair_cache = pair_cache_flag;
   LineDemo_setNumFrames(lineDemo, numFrames);
 
   const fasttime_t start_time = gettime();
@@ -139,6 +203,7 @@ int main(int argc, char *argv[]) {
   printf("%u Line-Line Collisions\n",
          LineDemo_getNumLineLineCollisions(lineDemo));
   printf("---- END RESULTS ----\n\n");
+  PHASE_TIMING_PRINT(stdout);
 
   // delete objects
   LineDemo_delete(lineDemo);
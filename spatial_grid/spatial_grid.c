@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../quad_tree/logging.h"
+#include "../quad_tree/small_list.h"
+#include "spatial_grid.h"
+
+// Upper bound on grid cells per line so tiny lines don't blow up the cell arrays
+#define MAX_CELLS_PER_LINE 2
+
+// PRIVATE DECLARATIONS
+static void SpatialGrid_SizeCells(SpatialGrid* grid, const unsigned int num_lines);
+static void SpatialGrid_Reserve(SpatialGrid* grid, const unsigned int num_lines);
+
+
+// INLINES
+// Maps a box coordinate to a cell index, clamping anything outside the box
+// into the border cells
+static inline int SpatialGrid_CellIndex(const double coord, const double box_min,
+                                        const double cell_size, const int num_cells) {
+  const double cell = (coord - box_min) / cell_size;
+  if(!(cell >= 0.0)) {
+    return 0;
+  }
+  if(cell >= (double)num_cells) {
+    return num_cells - 1;
+  }
+  return (int)cell;
+}
+
+// Cell range of the bounding box of the line's swept parallelogram
+static inline GridCellRange SpatialGrid_GetCellRange(const SpatialGrid* grid, const unsigned int line_id,
+                                                     const double time_step) {
+  const LineStore* lines = grid->lines;
+  const double dx = lines->vx[line_id] * time_step;
+  const double dy = lines->vy[line_id] * time_step;
+
+  double min_x = fmin(lines->p1x[line_id], lines->p2x[line_id]);
+  double max_x = fmax(lines->p1x[line_id], lines->p2x[line_id]);
+  double min_y = fmin(lines->p1y[line_id], lines->p2y[line_id]);
+  double max_y = fmax(lines->p1y[line_id], lines->p2y[line_id]);
+  min_x = fmin(min_x, min_x + dx);
+  max_x = fmax(max_x, max_x + dx);
+  min_y = fmin(min_y, min_y + dy);
+  max_y = fmax(max_y, max_y + dy);
+
+  GridCellRange range;
+  range.min_x = SpatialGrid_CellIndex(min_x, BOX_XMIN, grid->cell_size, grid->num_cells_x);
+  range.max_x = SpatialGrid_CellIndex(max_x, BOX_XMIN, grid->cell_size, grid->num_cells_x);
+  range.min_y = SpatialGrid_CellIndex(min_y, BOX_YMIN, grid->cell_size, grid->num_cells_y);
+  range.max_y = SpatialGrid_CellIndex(max_y, BOX_YMIN, grid->cell_size, grid->num_cells_y);
+  return range;
+}
+
+
+// PUBLIC
+void SpatialGrid_Init(SpatialGrid* grid, const LineStore* lines) {
+  assert(grid);
+  assert(lines);
+
+  grid->lines               = lines;
+  grid->cell_size           = 0.0;
+  grid->num_cells_x         = 0;
+  grid->num_cells_y         = 0;
+  grid->cell_start          = NULL;
+  grid->cell_lines          = NULL;
+  grid->cell_lines_capacity = 0;
+  grid->line_ranges         = NULL;
+  grid->num_lines           = 0;
+}
+
+void SpatialGrid_Free(SpatialGrid* grid) {
+  assert(grid);
+
+  free(grid->cell_start);
+  free(grid->cell_lines);
+  free(grid->line_ranges);
+  SpatialGrid_Init(grid, grid->lines);
+}
+
+void SpatialGrid_Build(SpatialGrid* grid, const unsigned int num_lines, const double time_step) {
+  assert(grid);
+
+  if(grid->cell_size == 0.0) {
+    SpatialGrid_SizeCells(grid, num_lines);
+  }
+  SpatialGrid_Reserve(grid, num_lines);
+
+  // count entries per cell into cell_start[c + 1]
+  const int num_cells = grid->num_cells_x * grid->num_cells_y;
+  memset(grid->cell_start, 0, (num_cells + 1) * sizeof(int));
+  unsigned int num_entries = 0;
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    const GridCellRange range = SpatialGrid_GetCellRange(grid, i, time_step);
+    grid->line_ranges[i] = range;
+    for(int y = range.min_y; y <= range.max_y; ++y) {
+      for(int x = range.min_x; x <= range.max_x; ++x) {
+        grid->cell_start[y * grid->num_cells_x + x + 1]++;
+      }
+    }
+    num_entries += (range.max_x - range.min_x + 1) * (range.max_y - range.min_y + 1);
+  }
+
+  if(num_entries > grid->cell_lines_capacity) {
+    free(grid->cell_lines);
+    grid->cell_lines_capacity = num_entries * 2;
+    grid->cell_lines = malloc(grid->cell_lines_capacity * sizeof(unsigned int));
+    if(!grid->cell_lines) {
+      LOG("%s(): Couldn't malloc for cell lines\n", __func__);
+      exit(1);
+    }
+  }
+
+  // prefix sum so cell_start[c] is where cell c begins
+  for(int c = 1; c <= num_cells; ++c) {
+    grid->cell_start[c] += grid->cell_start[c - 1];
+  }
+
+  // fill, using cell_start[c] as the write cursor for cell c
+  // afterwards cell_start[c] is where cell c + 1 begins so shift it back by one
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    const GridCellRange range = grid->line_ranges[i];
+    for(int y = range.min_y; y <= range.max_y; ++y) {
+      for(int x = range.min_x; x <= range.max_x; ++x) {
+        grid->cell_lines[grid->cell_start[y * grid->num_cells_x + x]++] = i;
+      }
+    }
+  }
+  for(int c = num_cells; c > 0; --c) {
+    grid->cell_start[c] = grid->cell_start[c - 1];
+  }
+  grid->cell_start[0] = 0;
+}
+
+SmallList SpatialGrid_QueryLines(const SpatialGrid* grid, const unsigned int line_id) {
+  assert(grid);
+  assert(line_id < grid->num_lines);
+
+  SmallList output;
+  SmallList_Init(&output, sizeof(unsigned int));
+
+  // A pair of lines can share several cells. It is only reported from the
+  // first cell they share (the min corner of the overlap of their ranges)
+  // so no list has to be searched for duplicates.
+  const GridCellRange range = grid->line_ranges[line_id];
+  for(int y = range.min_y; y <= range.max_y; ++y) {
+    for(int x = range.min_x; x <= range.max_x; ++x) {
+      const int cell = y * grid->num_cells_x + x;
+      for(int k = grid->cell_start[cell]; k < grid->cell_start[cell + 1]; ++k) {
+        const unsigned int other_id = grid->cell_lines[k];
+        if(other_id == line_id) {
+          continue;
+        }
+        const GridCellRange* other = &grid->line_ranges[other_id];
+        const int first_x = range.min_x > other->min_x ? range.min_x : other->min_x;
+        const int first_y = range.min_y > other->min_y ? range.min_y : other->min_y;
+        if(x == first_x && y == first_y) {
+          SmallList_PushBack(&output, &other_id);
+        }
+      }
+    }
+  }
+
+  return output;
+}
+
+
+// PRIVATE
+// Cells are squares about as long as the average line, capped so there are
+// at most MAX_CELLS_PER_LINE cells for each line
+static void SpatialGrid_SizeCells(SpatialGrid* grid, const unsigned int num_lines) {
+  const LineStore* lines = grid->lines;
+  double total_length = 0.0;
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    total_length += hypot(lines->p1x[i] - lines->p2x[i], lines->p1y[i] - lines->p2y[i]);
+  }
+
+  const double box_width  = (double)BOX_XMAX - BOX_XMIN;
+  const double box_height = (double)BOX_YMAX - BOX_YMIN;
+  double cell_size = num_lines > 0 ? total_length / num_lines : box_width;
+  const double min_cell_size = sqrt((box_width * box_height) / (MAX_CELLS_PER_LINE * (double)(num_lines + 1)));
+  if(!(cell_size >= min_cell_size)) {
+    cell_size = min_cell_size;
+  }
+
+  grid->cell_size   = cell_size;
+  grid->num_cells_x = (int)ceil(box_width  / cell_size);
+  grid->num_cells_y = (int)ceil(box_height / cell_size);
+}
+
+static void SpatialGrid_Reserve(SpatialGrid* grid, const unsigned int num_lines) {
+  if(grid->cell_start == NULL) {
+    grid->cell_start = malloc((grid->num_cells_x * grid->num_cells_y + 1) * sizeof(int));
+    if(!grid->cell_start) {
+      LOG("%s(): Couldn't malloc for cells\n", __func__);
+      exit(1);
+    }
+  }
+
+  if(grid->num_lines != num_lines) {
+    free(grid->line_ranges);
+    grid->line_ranges = malloc(num_lines * sizeof(GridCellRange));
+    if(!grid->line_ranges) {
+      LOG("%s(): Couldn't malloc for line ranges\n", __func__);
+      exit(1);
+    }
+    grid->num_lines = num_lines;
+  }
+}
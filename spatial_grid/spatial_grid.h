@@ -0,0 +1,49 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <stdbool.h>
+
+#include "../quad_tree/small_list.h"
+#include "../line.h"
+#include "../line_store.h"
+
+// Cell range a line's swept parallelogram covers, inclusive on both ends
+typedef struct GridCellRange {
+  int min_x;
+  int min_y;
+  int max_x;
+  int max_y;
+} GridCellRange;
+
+// Uniform grid over the box. Each line is binned into every cell that the
+// bounding box of its swept parallelogram touches.
+//
+// Cell contents are stored CSR style, rebuilt every frame with a counting sort:
+// the line ids of cell c are cell_lines[cell_start[c]] .. cell_lines[cell_start[c + 1] - 1]
+typedef struct SpatialGrid {
+  // SpatialGrid does not own this memory !!!
+  const LineStore* lines;
+
+  // cell side length in box coordinates, picked from the mean line length
+  // on the first build. 0 until then
+  double cell_size;
+  int    num_cells_x;
+  int    num_cells_y;
+
+  int*          cell_start;   // num_cells_x * num_cells_y + 1
+  unsigned int* cell_lines;
+  unsigned int  cell_lines_capacity;
+
+  // one per line, kept from the last build
+  GridCellRange* line_ranges;
+  unsigned int   num_lines;
+} SpatialGrid;
+
+void SpatialGrid_Init(SpatialGrid* grid, const LineStore* lines);
+void SpatialGrid_Free(SpatialGrid* grid);
+void SpatialGrid_Build(SpatialGrid* grid, const unsigned int num_lines, const double time_step);
+// Same contract as QuadTree_QueryLines: every other line sharing a cell with
+// line_id, each listed once. Caller frees the list
+SmallList SpatialGrid_QueryLines(const SpatialGrid* grid, const unsigned int line_id);
+
+#endif
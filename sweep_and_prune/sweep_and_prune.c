@@ -0,0 +1,169 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../quad_tree/logging.h"
+#include "../quad_tree/small_list.h"
+#include "sweep_and_prune.h"
+
+// PRIVATE DECLARATIONS
+static void SweepAndPrune_Reset(SweepAndPrune* sap, const unsigned int num_lines);
+static void SweepAndPrune_InsertionSort(SweepAndPrune* sap);
+static int  SweepAndPrune_CompareEntries(const void* a, const void* b);
+
+
+// INLINES
+static inline SweepBox SweepAndPrune_GetBox(const LineStore* lines, const unsigned int line_id,
+                                            const double time_step) {
+  SweepBox box;
+  LineStore_sweptBox(lines, line_id, time_step, &box.min_x, &box.max_x, &box.min_y, &box.max_y);
+  return box;
+}
+
+static inline bool SweepAndPrune_BoxesOverlap(const SweepBox* a, const SweepBox* b) {
+  return a->min_x <= b->max_x && b->min_x <= a->max_x &&
+         a->min_y <= b->max_y && b->min_y <= a->max_y;
+}
+
+
+// PUBLIC
+void SweepAndPrune_Init(SweepAndPrune* sap, const LineStore* lines) {
+  assert(sap);
+  assert(lines);
+
+  sap->lines     = lines;
+  sap->entries   = NULL;
+  sap->rank      = NULL;
+  sap->boxes     = NULL;
+  sap->num_lines = 0;
+  sap->max_width = 0.0;
+}
+
+void SweepAndPrune_Free(SweepAndPrune* sap) {
+  assert(sap);
+
+  free(sap->entries);
+  free(sap->rank);
+  free(sap->boxes);
+  SweepAndPrune_Init(sap, sap->lines);
+}
+
+void SweepAndPrune_Update(SweepAndPrune* sap, const unsigned int num_lines, const double time_step) {
+  assert(sap);
+
+  const bool starting_over = sap->num_lines != num_lines || sap->entries == NULL;
+  if(starting_over) {
+    SweepAndPrune_Reset(sap, num_lines);
+  }
+
+  double max_width = 0.0;
+  for(unsigned int i = 0; i < num_lines; ++i) {
+    const SweepBox box = SweepAndPrune_GetBox(sap->lines, i, time_step);
+    sap->boxes[i] = box;
+    if(box.max_x - box.min_x > max_width) {
+      max_width = box.max_x - box.min_x;
+    }
+  }
+  sap->max_width = max_width;
+
+  // refresh the keys in their current (last frame's) order then fix it up,
+  // a fresh list is in id order so it gets a full sort instead
+  for(unsigned int k = 0; k < num_lines; ++k) {
+    sap->entries[k].min_x = sap->boxes[sap->entries[k].line_id].min_x;
+  }
+  if(starting_over) {
+    qsort(sap->entries, num_lines, sizeof(SweepEntry), SweepAndPrune_CompareEntries);
+  }
+  else {
+    SweepAndPrune_InsertionSort(sap);
+  }
+
+  for(unsigned int k = 0; k < num_lines; ++k) {
+    sap->rank[sap->entries[k].line_id] = k;
+  }
+}
+
+SmallList SweepAndPrune_QueryLines(const SweepAndPrune* sap, const unsigned int line_id) {
+  assert(sap);
+  assert(line_id < sap->num_lines);
+
+  SmallList output;
+  SmallList_Init(&output, sizeof(unsigned int));
+
+  const SweepBox* box = &sap->boxes[line_id];
+  const unsigned int rank = sap->rank[line_id];
+
+  // lines after this one start at or after box->min_x,
+  // they stop overlapping once they start past box->max_x
+  for(unsigned int k = rank + 1; k < sap->num_lines; ++k) {
+    const SweepEntry* entry = &sap->entries[k];
+    if(entry->min_x > box->max_x) {
+      break;
+    }
+    if(SweepAndPrune_BoxesOverlap(box, &sap->boxes[entry->line_id])) {
+      SmallList_PushBack(&output, &entry->line_id);
+    }
+  }
+
+  // lines before this one start at or before box->min_x, none of them are
+  // wider than max_width so anything starting further back can't reach it
+  const double reach = box->min_x - sap->max_width;
+  for(unsigned int k = rank; k-- > 0;) {
+    const SweepEntry* entry = &sap->entries[k];
+    if(entry->min_x < reach) {
+      break;
+    }
+    if(SweepAndPrune_BoxesOverlap(box, &sap->boxes[entry->line_id])) {
+      SmallList_PushBack(&output, &entry->line_id);
+    }
+  }
+
+  return output;
+}
+
+
+// PRIVATE
+static void SweepAndPrune_Reset(SweepAndPrune* sap, const unsigned int num_lines) {
+  free(sap->entries);
+  free(sap->rank);
+  free(sap->boxes);
+
+  sap->entries = malloc(num_lines * sizeof(SweepEntry));
+  sap->rank    = malloc(num_lines * sizeof(unsigned int));
+  sap->boxes   = malloc(num_lines * sizeof(SweepBox));
+  if(!sap->entries || !sap->rank || !sap->boxes) {
+    LOG("%s(): Couldn't malloc for sweep and prune\n", __func__);
+    exit(1);
+  }
+
+  for(unsigned int k = 0; k < num_lines; ++k) {
+    sap->entries[k].line_id = k;
+  }
+  sap->num_lines = num_lines;
+}
+
+// Stable, and linear when the list barely changed since last frame
+static void SweepAndPrune_InsertionSort(SweepAndPrune* sap) {
+  SweepEntry* entries = sap->entries;
+  for(unsigned int k = 1; k < sap->num_lines; ++k) {
+    const SweepEntry entry = entries[k];
+    unsigned int j = k;
+    while(j > 0 && entries[j - 1].min_x > entry.min_x) {
+      entries[j] = entries[j - 1];
+      --j;
+    }
+    entries[j] = entry;
+  }
+}
+
+static int SweepAndPrune_CompareEntries(const void* a, const void* b) {
+  const SweepEntry* entry_a = a;
+  const SweepEntry* entry_b = b;
+  if(entry_a->min_x < entry_b->min_x) {
+    return -1;
+  }
+  if(entry_a->min_x > entry_b->min_x) {
+    return 1;
+  }
+  return entry_a->line_id < entry_b->line_id ? -1 : entry_a->line_id > entry_b->line_id;
+}
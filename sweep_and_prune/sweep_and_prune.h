@@ -0,0 +1,51 @@
+#ifndef SWEEP_AND_PRUNE_H
+#define SWEEP_AND_PRUNE_H
+
+#include <stdbool.h>
+
+#include "../quad_tree/small_list.h"
+#include "../line.h"
+#include "../line_store.h"
+
+// One entry of the sorted list, keyed on the low x of the line's swept box
+typedef struct SweepEntry {
+  double       min_x;
+  unsigned int line_id;
+} SweepEntry;
+
+// Bounding box of a line's swept parallelogram, box coordinates, see LineStore_sweptBox
+typedef struct SweepBox {
+  double min_x;
+  double max_x;
+  double min_y;
+  double max_y;
+} SweepBox;
+
+// Sort and sweep along x.
+//
+// The sorted list is kept between frames. Lines only move a little each frame
+// so the list is nearly sorted already and an insertion sort fixes it up in
+// close to linear time.
+typedef struct SweepAndPrune {
+  // SweepAndPrune does not own this memory !!!
+  const LineStore* lines;
+
+  SweepEntry*   entries;  // sorted by min_x
+  unsigned int* rank;     // rank[line_id] is the index of the line in entries
+  SweepBox*     boxes;    // indexed by line id
+  unsigned int  num_lines;
+
+  // widest box along x this frame, bounds how far back a query has to look
+  double max_width;
+} SweepAndPrune;
+
+void SweepAndPrune_Init(SweepAndPrune* sap, const LineStore* lines);
+void SweepAndPrune_Free(SweepAndPrune* sap);
+// Recomputes the boxes and re-sorts the list. The first call (or a change
+// in the number of lines) starts the list over
+void SweepAndPrune_Update(SweepAndPrune* sap, const unsigned int num_lines, const double time_step);
+// Same contract as QuadTree_QueryLines: every other line whose box overlaps
+// line_id's box, each listed once. Caller frees the list
+SmallList SweepAndPrune_QueryLines(const SweepAndPrune* sap, const unsigned int line_id);
+
+#endif
@@ -27,20 +27,17 @@
 #include "./line.h"
 
 Vec Vec_make(const vec_dimension x, const vec_dimension y) {
-  Vec vector;
-  vector.x = x;
-  vector.y = y;
-  return vector;
+  return Vec2_make(x, y);
 }
 
 Vec Vec_makeFromLine(struct Line line) {
-  return Vec_subtract(line.p1, line.p2);
+  return Vec2_subtract(line.p1, line.p2);
 }
 
 // ************************* Fundamental attributes **************************
 
 vec_dimension Vec_length(Vec vector) {
-  return hypot(vector.x, vector.y);
+  return Vec2_length(vector);
 }
 
 double Vec_argument(Vec vector) {
@@ -50,11 +47,11 @@ double Vec_argument(Vec vector) {
 // **************************** Related vectors ******************************
 
 Vec Vec_normalize(Vec vector) {
-  return Vec_divide(vector, Vec_length(vector));
+  return Vec2_normalize(vector);
 }
 
 Vec Vec_orthogonal(Vec vector) {
-  return Vec_make(-vector.y, vector.x);
+  return Vec2_orthogonal(vector);
 }
 
 // ******************** Relationships with other vectors *********************
@@ -74,29 +71,29 @@ Vec Vec_projectOnto(Vec vector1, Vec vector2) {
 // ******************************* Arithmetic ********************************
 
 bool Vec_equals(Vec lhs, Vec rhs) {
-  return lhs.x == rhs.x && lhs.y == rhs.y;
+  return Vec2_equals(lhs, rhs);
 }
 
 Vec Vec_add(Vec lhs, Vec rhs) {
-  return Vec_make(lhs.x + rhs.x, lhs.y + rhs.y);
+  return Vec2_add(lhs, rhs);
 }
 
 Vec Vec_subtract(Vec lhs, Vec rhs) {
-  return Vec_make(lhs.x - rhs.x, lhs.y - rhs.y);
+  return Vec2_subtract(lhs, rhs);
 }
 
 Vec Vec_multiply(Vec vector, const double scalar) {
-  return Vec_make(vector.x * scalar, vector.y * scalar);
+  return Vec2_multiply(vector, scalar);
 }
 
 Vec Vec_divide(Vec vector, const double scalar) {
-  return Vec_make(vector.x / scalar, vector.y / scalar);
+  return Vec2_divide(vector, scalar);
 }
 
 vec_dimension Vec_dotProduct(Vec lhs, Vec rhs) {
-  return lhs.x * rhs.x + lhs.y * rhs.y;
+  return Vec2_dotProduct(lhs, rhs);
 }
 
 vec_dimension Vec_crossProduct(Vec lhs, Vec rhs) {
-  return lhs.x * rhs.y - lhs.y * rhs.x;
+  return Vec2_crossProduct(lhs, rhs);
 }